@@ -2,9 +2,112 @@
 #define DATA_STREAMER_TEMPLATE_H
 
 #include <mutex>
+#include <memory>
+#include <algorithm>
 #include <unordered_set>
 #include "PlotJuggler/plotdata.h"
 #include "PlotJuggler/pj_plugin.h"
+#include "PlotJuggler/spsc_queue.h"
+
+/**
+ * @brief Samples collected by a streaming thread, to be published with
+ * DataStreamer::publishBatch().
+ *
+ * Its memory is recycled: once the batch has been consumed, it comes back to
+ * the producer with its capacity (and strings) preserved.
+ */
+class SampleBatch
+{
+public:
+
+    /// Handle of the name of a timeseries, see DataStreamer::streamID().
+    typedef uint32_t StreamID;
+
+    template <typename PointType> struct Sample{
+        StreamID id;
+        PointType point;
+    };
+
+    typedef Sample<PlotData::Point>    NumericSample;
+    typedef Sample<PlotDataAny::Point> UserDefinedSample;
+
+    void pushNumeric(StreamID id, PlotData::Point point)
+    {
+        if( _numeric_count == _numeric.size() ){
+            _numeric.emplace_back();
+        }
+        auto& sample = _numeric[_numeric_count++];
+        sample.id    = id;
+        sample.point = point;
+    }
+
+    void pushUserDefined(StreamID id, PlotDataAny::Point point)
+    {
+        if( _user_defined_count == _user_defined.size() ){
+            _user_defined.emplace_back();
+        }
+        auto& sample = _user_defined[_user_defined_count++];
+        sample.id    = id;
+        sample.point = std::move(point);
+    }
+
+    /// Remove the samples, but keep the allocated memory.
+    void clear()
+    {
+        clearSamples();
+        _new_names.clear();
+        _clear_destination = false;
+    }
+
+    /**
+     * Drop the samples pushed so far. When the batch is appended, all the timeseries
+     * of the application are cleared first, together with the samples of the batches
+     * published before. Used, for instance, when the clock goes back in time.
+     */
+    void clearDestination()
+    {
+        clearSamples();
+        _clear_destination = true;
+    }
+
+    bool clearsDestination() const { return _clear_destination; }
+
+    bool empty() const
+    {
+        return _numeric_count == 0 && _user_defined_count == 0 &&
+               _new_names.empty() && !_clear_destination;
+    }
+
+    size_t numericCount() const { return _numeric_count; }
+
+    size_t userDefinedCount() const { return _user_defined_count; }
+
+    const NumericSample& numeric(size_t index) const { return _numeric[index]; }
+
+    UserDefinedSample& userDefined(size_t index) { return _user_defined[index]; }
+
+    /// Names of the IDs created while the batch was filled, in the order of their IDs.
+    const std::vector<std::string>& newNames() const { return _new_names; }
+
+private:
+    friend class DataStreamer;
+
+    void clearSamples()
+    {
+        for (size_t i=0; i<_user_defined_count; i++) {
+            _user_defined[i].point.y = nonstd::any();
+        }
+        _numeric_count = 0;
+        _user_defined_count = 0;
+    }
+
+    std::vector<NumericSample> _numeric;
+    std::vector<UserDefinedSample> _user_defined;
+    size_t _numeric_count = 0;
+    size_t _user_defined_count = 0;
+    std::vector<std::string> _new_names;
+    bool _clear_destination = false;
+};
 
 /**
  * @brief The DataStreamer base class to create your own plugin.
@@ -13,6 +116,10 @@
  * dataMap(), which share its elements with the main application, is protected by the mutex()
  *
  * This includes in particular the periodic updates.
+ *
+ * Alternatively, a single streaming thread can avoid the mutex altogether:
+ * it fills streamBatch() and calls publishBatch(), that hands the samples over
+ * to the application through a lock-free queue.
  */
 class DataStreamer: public PlotJugglerPlugin
 {
@@ -20,7 +127,11 @@ class DataStreamer: public PlotJugglerPlugin
 public:
 
     DataStreamer():
-        PlotJugglerPlugin()
+        PlotJugglerPlugin(),
+        _batch_queue(BATCH_QUEUE_CAPACITY),
+        _recycled_batches(BATCH_QUEUE_CAPACITY),
+        _maximum_range( std::numeric_limits<double>::max() ),
+        _memory_budget(0)
     {
 
     }
@@ -40,8 +151,41 @@ public:
 
     void setMaximumRange(double range);
 
+    /// Memory budget of each timeseries, see PlotDataGeneric::setMemoryBudget().
+    void setMemoryBudget(size_t bytes);
+
+    /**
+     * Called by the application, with mutex() locked, to move the content of dataMap()
+     * into destination. Blocks of samples are moved without copying whenever possible.
+     * Returns the names of the new timeseries.
+     */
     virtual std::vector<QString> appendData(PlotDataMapRef& destination);
 
+    /// Batch being filled by the streaming thread. Don't use it from any other thread.
+    SampleBatch& streamBatch();
+
+    /**
+     * Handle of the timeseries called name, to push its samples into streamBatch().
+     * It never changes: the streaming thread should resolve it once and keep it,
+     * so that neither the name is copied nor it is looked up for each sample.
+     * Like streamBatch(), it must be called only by the streaming thread.
+     */
+    SampleBatch::StreamID streamID(const std::string& name);
+
+    /**
+     * Called by the streaming thread to publish streamBatch(), without locking.
+     * If the application is busy and the queue is full, the batch is kept and the
+     * following samples are appended to it; nothing is lost.
+     */
+    void publishBatch();
+
+    /**
+     * Called by the application to move the published batches into destination.
+     * It doesn't need mutex(). Returns the names of the new timeseries.
+     * cleared is set if the timeseries were cleared (see SampleBatch::clearDestination()).
+     */
+    std::vector<QString> appendBatches(PlotDataMapRef& destination, bool* cleared = nullptr);
+
     PlotDataMapRef& dataMap()
     {
         return _data_map;
@@ -61,9 +205,46 @@ signals:
     void connectionClosed();
 
 private:
+    enum { BATCH_QUEUE_CAPACITY = 256 };
+
+    template <typename T>
+    void findMergeTargets(std::unordered_map<std::string,T>& source,
+                                 std::unordered_map<std::string,T>& destination,
+                                 std::vector<std::pair<T*,T*>>& targets,
+                                 std::vector<QString>* added_curves);
+
+    void updateMergeTargets(PlotDataMapRef& destination, std::vector<QString>& added_curves);
+
+    template <typename T>
+    T* findBatchTarget(std::unordered_map<std::string,T>& destination, SampleBatch::StreamID id,
+                       std::vector<QString>* added_curves);
+
     std::mutex _mutex;
     PlotDataMapRef _data_map;
     QAction* _start_streamer;
+
+    std::unique_ptr<SampleBatch> _stream_batch;
+    SPSCQueue<std::unique_ptr<SampleBatch>> _batch_queue;
+    SPSCQueue<std::unique_ptr<SampleBatch>> _recycled_batches;
+    std::atomic<double> _maximum_range;
+    std::atomic<size_t> _memory_budget;
+
+    // used by streamID(), in the streaming thread
+    std::unordered_map<std::string, SampleBatch::StreamID> _stream_ids;
+
+    // used by appendBatches(), indexed by StreamID. The pointers are resolved
+    // once, and dropped when a timeseries of the destination is erased
+    std::vector<std::string> _batch_names;
+    std::vector<PlotData*> _batch_numeric_targets;
+    std::vector<PlotDataAny*> _batch_user_defined_targets;
+    const PlotDataMapRef* _batch_destination = nullptr;
+    size_t _batch_erase_count = 0;
+
+    // (source, destination) pairs used by appendData()
+    std::vector<std::pair<PlotData*,PlotData*>> _numeric_targets;
+    std::vector<std::pair<PlotDataAny*,PlotDataAny*>> _user_defined_targets;
+    const PlotDataMapRef* _targets_destination = nullptr;
+    std::pair<size_t,size_t> _targets_erase_count;
 };
 
 QT_BEGIN_NAMESPACE
@@ -80,6 +261,7 @@ QT_END_NAMESPACE
 inline
 void DataStreamer::setMaximumRange(double range)
 {
+    _maximum_range = range;
     std::lock_guard<std::mutex> lock( mutex() );
     for (auto& it : dataMap().numeric ) {
         it.second.setMaximumRangeX( range );
@@ -90,67 +272,213 @@ void DataStreamer::setMaximumRange(double range)
 }
 
 inline
-std::vector<QString> DataStreamer::appendData(PlotDataMapRef &destination)
+void DataStreamer::setMemoryBudget(size_t bytes)
 {
-    PlotDataMapRef &source = _data_map;
+    _memory_budget = bytes;
+    std::lock_guard<std::mutex> lock( mutex() );
+    for (auto& it : dataMap().numeric ) {
+        it.second.setMemoryBudget( bytes );
+    }
+    for (auto& it: dataMap().user_defined) {
+        it.second.setMemoryBudget( bytes );
+    }
+}
 
+inline
+std::vector<QString> DataStreamer::appendData(PlotDataMapRef &destination)
+{
     std::vector<QString> added_curves;
-    for (auto& it: _data_map.numeric)
+    updateMergeTargets( destination, added_curves );
+
+    for (auto& target: _numeric_targets)
     {
-        const std::string& name  = it.first;
-        if( it.second.size()>0 && destination.numeric.count(name) == 0)
-        {
-            added_curves.push_back( QString::fromStdString( name ) );
-        }
+        target.second->spliceBack( *target.first );
     }
+    for (auto& target: _user_defined_targets)
+    {
+        target.second->spliceBack( *target.first );
+    }
+    return added_curves;
+}
 
-    for (auto& it: source.numeric)
+template <typename T> inline
+void DataStreamer::findMergeTargets(std::unordered_map<std::string,T>& source,
+                                    std::unordered_map<std::string,T>& destination,
+                                    std::vector<std::pair<T*,T*>>& targets,
+                                    std::vector<QString>* added_curves)
+{
+    targets.clear();
+    for (auto& it: source)
     {
         const std::string& name  = it.first;
         auto& source_plot  = it.second;
-        auto plot_with_same_name = destination.numeric.find(name);
+        auto plot_with_same_name = destination.find(name);
 
         // this is a new plot
-        if( plot_with_same_name == destination.numeric.end() )
+        if( plot_with_same_name == destination.end() )
         {
-            plot_with_same_name = destination.numeric.emplace(
+            if( added_curves && source_plot.size() > 0 )
+            {
+                added_curves->push_back( QString::fromStdString( name ) );
+            }
+            plot_with_same_name = destination.emplace(
                         std::piecewise_construct,
                         std::forward_as_tuple(name),
                         std::forward_as_tuple(name)
                         ).first;
+            plot_with_same_name->second.setMaximumRangeX( _maximum_range );
+            plot_with_same_name->second.setMemoryBudget( _memory_budget );
         }
-        auto& destination_plot = plot_with_same_name->second;
-        for (size_t i=0; i< source_plot.size(); i++)
-        {
-            destination_plot.pushBack( source_plot.at(i) );
+        targets.push_back( { &source_plot, &plot_with_same_name->second } );
+    }
+}
+
+inline
+void DataStreamer::updateMergeTargets(PlotDataMapRef &destination, std::vector<QString>& added_curves)
+{
+    // Pointers to the elements of an unordered_map remain valid until they are erased,
+    // therefore the lookup by name is repeated only when the timeseries change
+    const bool valid = ( _targets_destination == &destination &&
+                         _targets_erase_count.first  == _data_map.erase_count &&
+                         _targets_erase_count.second == destination.erase_count &&
+                         _numeric_targets.size() == _data_map.numeric.size() &&
+                         _user_defined_targets.size() == _data_map.user_defined.size() );
+    if( valid )
+    {
+        return;
+    }
+    findMergeTargets( _data_map.numeric, destination.numeric, _numeric_targets, &added_curves );
+    findMergeTargets( _data_map.user_defined, destination.user_defined, _user_defined_targets, nullptr );
+
+    _targets_destination = &destination;
+    _targets_erase_count = { _data_map.erase_count, destination.erase_count };
+}
+
+inline
+SampleBatch& DataStreamer::streamBatch()
+{
+    if( !_stream_batch )
+    {
+        if( !_recycled_batches.pop( _stream_batch ) ){
+            _stream_batch.reset( new SampleBatch );
         }
-        source_plot.clear();
     }
+    return *_stream_batch;
+}
 
-    for (auto& it: source.user_defined)
+inline
+SampleBatch::StreamID DataStreamer::streamID(const std::string &name)
+{
+    auto it = _stream_ids.find( name );
+    if( it == _stream_ids.end() )
     {
-        const std::string& name  = it.first;
-        auto& source_plot  = it.second;
-        auto plot_with_same_name = destination.user_defined.find(name);
+        it = _stream_ids.insert( { name, SampleBatch::StreamID( _stream_ids.size() ) } ).first;
+        // the name is published before (or with) the first sample that uses it
+        streamBatch()._new_names.push_back( name );
+    }
+    return it->second;
+}
 
-        // this is a new plot
-        if( plot_with_same_name == destination.user_defined.end() )
+inline
+void DataStreamer::publishBatch()
+{
+    if( _stream_batch && !_stream_batch->empty() )
+    {
+        // if it fails, _stream_batch is untouched and will be published later
+        _batch_queue.push( std::move(_stream_batch) );
+    }
+}
+
+inline
+std::vector<QString> DataStreamer::appendBatches(PlotDataMapRef &destination, bool* cleared)
+{
+    std::vector<QString> added_curves;
+    if( cleared )
+    {
+        *cleared = false;
+    }
+
+    if( _batch_destination != &destination || _batch_erase_count != destination.erase_count )
+    {
+        std::fill( _batch_numeric_targets.begin(), _batch_numeric_targets.end(), nullptr );
+        std::fill( _batch_user_defined_targets.begin(), _batch_user_defined_targets.end(), nullptr );
+        _batch_destination = &destination;
+        _batch_erase_count = destination.erase_count;
+    }
+
+    std::unique_ptr<SampleBatch> batch;
+    while( _batch_queue.pop( batch ) )
+    {
+        for (const auto& name: batch->newNames())
         {
-            plot_with_same_name = destination.user_defined.emplace(
-                        std::piecewise_construct,
-                        std::forward_as_tuple(name),
-                        std::forward_as_tuple(name)
-                        ).first;
+            _batch_names.push_back( name );
+            _batch_numeric_targets.push_back( nullptr );
+            _batch_user_defined_targets.push_back( nullptr );
         }
-        auto& destination_plot = plot_with_same_name->second;
-        for (size_t i=0; i< source_plot.size(); i++)
+
+        if( batch->clearsDestination() )
+        {
+            for (auto& it: destination.numeric ) {
+                it.second.clear();
+            }
+            for (auto& it: destination.user_defined ) {
+                it.second.clear();
+            }
+            if( cleared )
+            {
+                *cleared = true;
+            }
+        }
+
+        for (size_t i=0; i < batch->numericCount(); i++)
         {
-            destination_plot.pushBack( source_plot.at(i) );
+            const auto& sample = batch->numeric(i);
+            PlotData*& plot = _batch_numeric_targets[sample.id];
+            if( !plot )
+            {
+                plot = findBatchTarget( destination.numeric, sample.id, &added_curves );
+            }
+            plot->pushBack( sample.point );
         }
-        source_plot.clear();
+
+        for (size_t i=0; i < batch->userDefinedCount(); i++)
+        {
+            auto& sample = batch->userDefined(i);
+            PlotDataAny*& plot = _batch_user_defined_targets[sample.id];
+            if( !plot )
+            {
+                plot = findBatchTarget( destination.user_defined, sample.id, nullptr );
+            }
+            plot->pushBack( std::move(sample.point) );
+        }
+
+        batch->clear();
+        _recycled_batches.push( std::move(batch) ); // dropped if full
     }
     return added_curves;
 }
 
+template <typename T> inline
+T* DataStreamer::findBatchTarget(std::unordered_map<std::string,T>& destination,
+                                 SampleBatch::StreamID id,
+                                 std::vector<QString>* added_curves)
+{
+    const std::string& name = _batch_names[id];
+    auto plot_it = destination.find( name );
+    if( plot_it == destination.end() )
+    {
+        plot_it = destination.emplace( std::piecewise_construct,
+                                       std::forward_as_tuple(name),
+                                       std::forward_as_tuple(name) ).first;
+        plot_it->second.setMaximumRangeX( _maximum_range );
+        plot_it->second.setMemoryBudget( _memory_budget );
+        if( added_curves )
+        {
+            added_curves->push_back( QString::fromStdString( name ) );
+        }
+    }
+    return &plot_it->second;
+}
+
 #endif
 
@@ -6,7 +6,12 @@
 #include <string>
 #include <map>
 #include <mutex>
+#include <atomic>
 #include <deque>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <cstdint>
 #include "PlotJuggler/optional.hpp"
 #include "PlotJuggler/any.hpp"
 #include <QDebug>
@@ -21,6 +26,425 @@ inline double Abs(double val)
     return val < 0 ? -val : val;
 }
 
+/**
+ * Min/max pyramid of the values stored in the chunks of a PlotDataGeneric.
+ *
+ * The finest level has one entry for each bucket of LOD_BUCKET_SIZE samples;
+ * the coarser ones are a segment tree over whole chunks, i.e. buckets of
+ * ChunkSize * 2^k samples. Chunks are addressed by their sequence number,
+ * modulo the capacity, so that they can be added at the back and removed from
+ * the front without moving the others.
+ *
+ * It is an empty shell when Value is not a number.
+ */
+template <typename Value, size_t ChunkSize, bool = std::is_arithmetic<Value>::value>
+class ChunkRangeSummary
+{
+public:
+  void reset(size_t) {}
+  void reserve(size_t) {}
+  void pushChunk(size_t) {}
+  void popChunk() {}
+  void extend(size_t, size_t, const Value&) {}
+  void copyChunk(size_t, const ChunkRangeSummary&, size_t) {}
+  template <typename F> void transformChunk(size_t, F) {}
+  void setDirty() {}
+  bool isDirty() const { return false; }
+};
+
+template <typename Value, size_t ChunkSize>
+class ChunkRangeSummary<Value, ChunkSize, true>
+{
+public:
+
+  enum{
+    LOD_BUCKET_SIZE = 32,
+    BUCKETS_PER_CHUNK = ChunkSize / LOD_BUCKET_SIZE
+  };
+
+  struct MinMax{
+    Value min;
+    Value max;
+  };
+
+  static MinMax empty()
+  {
+    return { std::numeric_limits<Value>::max(), std::numeric_limits<Value>::lowest() };
+  }
+
+  static MinMax merge(const MinMax& a, const MinMax& b)
+  {
+    return { std::min(a.min, b.min), std::max(a.max, b.max) };
+  }
+
+  /// Remove everything and make room for chunks_count chunks. Memory is kept for reuse.
+  void reset(size_t chunks_count)
+  {
+    while( _capacity < chunks_count ){
+      _capacity *= 2;
+    }
+    _tree.assign( 2*_capacity, empty() );
+    _buckets.assign( _capacity * BUCKETS_PER_CHUNK, empty() );
+    _seq_front = 0;
+    _count = 0;
+    _dirty = false;
+  }
+
+  /// Make room for chunks_count chunks, keeping the current ones.
+  void reserve(size_t chunks_count)
+  {
+    if( _dirty || chunks_count <= _capacity ){
+      return;
+    }
+    std::vector<MinMax> old_leaves( _count );
+    std::vector<MinMax> old_buckets( _count * BUCKETS_PER_CHUNK );
+    for(size_t i=0; i<_count; i++)
+    {
+      old_leaves[i] = _tree[ leaf(i) ];
+      std::copy_n( &_buckets[ bucket(i,0) ], size_t(BUCKETS_PER_CHUNK), &old_buckets[ i*BUCKETS_PER_CHUNK ] );
+    }
+    reset( chunks_count );
+    for(size_t i=0; i<old_leaves.size(); i++)
+    {
+      _tree[ leaf(i) ] = old_leaves[i];
+      std::copy_n( &old_buckets[ i*BUCKETS_PER_CHUNK ], size_t(BUCKETS_PER_CHUNK), &_buckets[ bucket(i,0) ] );
+    }
+    _count = old_leaves.size();
+    build();
+  }
+
+  /// A new chunk was added at the back.
+  void pushChunk(size_t chunks_count)
+  {
+    if( _dirty ){
+      return;
+    }
+    reserve( chunks_count );
+    std::fill_n( &_buckets[ bucket(_count,0) ], size_t(BUCKETS_PER_CHUNK), empty() );
+    _count++;
+  }
+
+  /// The first chunk was removed.
+  void popChunk()
+  {
+    if( _dirty ){
+      return;
+    }
+    setLeaf( 0, empty() );
+    _seq_front++;
+    _count--;
+  }
+
+  /// A value was stored in the chunk at position chunk_index, at the given offset.
+  void extend(size_t chunk_index, size_t offset, const Value& val)
+  {
+    if( _dirty ){
+      return;
+    }
+    MinMax& fine = _buckets[ bucket(chunk_index, offset / LOD_BUCKET_SIZE) ];
+    fine.min = std::min( fine.min, val );
+    fine.max = std::max( fine.max, val );
+
+    const MinMax& prev = _tree[ leaf(chunk_index) ];
+    if( val < prev.min || val > prev.max )
+    {
+      setLeaf( chunk_index, merge( prev, {val, val} ) );
+    }
+  }
+
+  /// A chunk moved from another series was added at the back, see pushChunk().
+  void copyChunk(size_t chunk_index, const ChunkRangeSummary& other, size_t other_index)
+  {
+    if( _dirty ){
+      return;
+    }
+    std::copy_n( &other._buckets[ other.bucket(other_index,0) ], size_t(BUCKETS_PER_CHUNK),
+                 &_buckets[ bucket(chunk_index,0) ] );
+    setLeaf( chunk_index, other._tree[ other.leaf(other_index) ] );
+  }
+
+  /// The values of a chunk were replaced by f(value), where f is non-decreasing.
+  template <typename F>
+  void transformChunk(size_t chunk_index, F f)
+  {
+    if( _dirty ){
+      return;
+    }
+    auto transform = [&f](MinMax& range)
+    {
+      if( range.min <= range.max ){ // not empty
+        range = { f(range.min), f(range.max) };
+      }
+    };
+    for (size_t b=0; b < BUCKETS_PER_CHUNK; b++){
+      transform( _buckets[ bucket(chunk_index, b) ] );
+    }
+    MinMax chunk_leaf = _tree[ leaf(chunk_index) ];
+    transform( chunk_leaf );
+    setLeaf( chunk_index, chunk_leaf );
+  }
+
+  /// Values were modified in place; the summary must be rebuilt before the next query.
+  void setDirty() { _dirty = true; }
+
+  bool isDirty() const { return _dirty; }
+
+  /// Used to rebuild the summary: reset(), then initBucket() for each bucket, then build().
+  void initBucket(size_t chunk_index, size_t bucket_index, MinMax value)
+  {
+    _buckets[ bucket(chunk_index, bucket_index) ] = value;
+    MinMax& chunk_leaf = _tree[ leaf(chunk_index) ];
+    chunk_leaf = merge( chunk_leaf, value );
+    _count = std::max( _count, chunk_index+1 );
+  }
+
+  void build()
+  {
+    for(size_t i = _capacity-1; i > 0; i--){
+      _tree[i] = merge( _tree[2*i], _tree[2*i+1] );
+    }
+    _dirty = false;
+  }
+
+  /// Min/max over the chunks in the interval [first_chunk, last_chunk).
+  MinMax queryChunks(size_t first_chunk, size_t last_chunk) const
+  {
+    MinMax res = empty();
+    if( first_chunk >= last_chunk ){
+      return res;
+    }
+    size_t l = (_seq_front + first_chunk) & (_capacity-1);
+    size_t r = (_seq_front + last_chunk) & (_capacity-1);
+    if( l < r ){
+      res = queryLeaves( l, r );
+    }
+    else { // wrapped around
+      res = merge( queryLeaves( l, _capacity ), queryLeaves( 0, r ) );
+    }
+    return res;
+  }
+
+  /// Min/max over the buckets [first_bucket, last_bucket) of a single chunk.
+  MinMax queryBuckets(size_t chunk_index, size_t first_bucket, size_t last_bucket) const
+  {
+    MinMax res = empty();
+    for(size_t b = first_bucket; b < last_bucket; b++){
+      res = merge( res, _buckets[ bucket(chunk_index, b) ] );
+    }
+    return res;
+  }
+
+private:
+
+  size_t leaf(size_t chunk_index) const
+  {
+    return _capacity + ((_seq_front + chunk_index) & (_capacity-1));
+  }
+
+  size_t bucket(size_t chunk_index, size_t bucket_index) const
+  {
+    return ((_seq_front + chunk_index) & (_capacity-1)) * BUCKETS_PER_CHUNK + bucket_index;
+  }
+
+  void setLeaf(size_t chunk_index, MinMax value)
+  {
+    size_t pos = leaf(chunk_index);
+    _tree[pos] = value;
+    for( pos /= 2; pos > 0; pos /= 2 ){
+      _tree[pos] = merge( _tree[2*pos], _tree[2*pos+1] );
+    }
+  }
+
+  MinMax queryLeaves(size_t l, size_t r) const
+  {
+    MinMax res = empty();
+    for( l += _capacity, r += _capacity; l < r; l /= 2, r /= 2 )
+    {
+      if( l & 1 ) res = merge( res, _tree[l++] );
+      if( r & 1 ) res = merge( res, _tree[--r] );
+    }
+    return res;
+  }
+
+  std::vector<MinMax> _tree = std::vector<MinMax>( 8, empty() );
+  std::vector<MinMax> _buckets = std::vector<MinMax>( 4*BUCKETS_PER_CHUNK, empty() );
+  size_t _capacity = 4;
+  size_t _seq_front = 0;
+  size_t _count = 0;
+  bool _dirty = false;
+};
+
+/**
+ * Queue stored in a circular buffer. Unlike std::deque, push_back() and
+ * pop_front() don't allocate once the capacity is reached.
+ */
+template <typename T> class ChunkQueue
+{
+public:
+  ChunkQueue() = default;
+
+  ChunkQueue(ChunkQueue&& other) { *this = std::move(other); }
+
+  ChunkQueue& operator = (ChunkQueue&& other)
+  {
+    _buffer = std::move(other._buffer);
+    _head = other._head;
+    _size = other._size;
+    other._buffer.clear();
+    other._head = 0;
+    other._size = 0;
+    return *this;
+  }
+
+  size_t size() const { return _size; }
+
+  bool empty() const { return _size == 0; }
+
+  T& operator[](size_t index) { return _buffer[ (_head + index) & (_buffer.size()-1) ]; }
+
+  const T& operator[](size_t index) const { return _buffer[ (_head + index) & (_buffer.size()-1) ]; }
+
+  T& front() { return (*this)[0]; }
+
+  T& back() { return (*this)[_size-1]; }
+
+  const T& back() const { return (*this)[_size-1]; }
+
+  void push_back(T&& item)
+  {
+    if( _size == _buffer.size() ){
+      reserve( std::max<size_t>( 4, 2*_size ) );
+    }
+    (*this)[_size] = std::move(item);
+    _size++;
+  }
+
+  void pop_front()
+  {
+    front() = T();
+    _head = (_head + 1) & (_buffer.size()-1);
+    _size--;
+  }
+
+  void pop_back()
+  {
+    back() = T();
+    _size--;
+  }
+
+  void clear()
+  {
+    for (size_t i=0; i<_size; i++){
+      (*this)[i] = T();
+    }
+    _head = 0;
+    _size = 0;
+  }
+
+  void reserve(size_t capacity)
+  {
+    size_t new_capacity = std::max<size_t>( 1, _buffer.size() );
+    while( new_capacity < capacity ){
+      new_capacity *= 2;
+    }
+    if( new_capacity == _buffer.size() ){
+      return;
+    }
+    std::vector<T> buffer( new_capacity );
+    for (size_t i=0; i<_size; i++){
+      buffer[i] = std::move( (*this)[i] );
+    }
+    _buffer = std::move(buffer);
+    _head = 0;
+  }
+
+private:
+  std::vector<T> _buffer; // size is a power of two
+  size_t _head = 0;
+  size_t _size = 0;
+};
+
+/**
+ * Block of samples stored with reduced precision, see PlotDataGeneric::setCompactStorage().
+ * Values are stored as float; timestamps as a period, when they are regular,
+ * otherwise as float offsets from the first one.
+ *
+ * It is an empty shell when Value is not a number.
+ */
+template <typename Time, typename Value, size_t ChunkSize, bool = std::is_arithmetic<Value>::value>
+class CompactChunk
+{
+public:
+  static bool isSupported() { return false; }
+  static Value round(const Value& val) { return val; }
+  void encode(const Time*, const Value*, size_t) {}
+  void decode(Time*, Value*) const {}
+  Time x(size_t) const { return Time(); }
+  const Value& y(size_t) const { static const Value empty; return empty; }
+};
+
+template <typename Time, typename Value, size_t ChunkSize>
+class CompactChunk<Time, Value, ChunkSize, true>
+{
+public:
+  static bool isSupported() { return true; }
+
+  static Value round(Value val) { return static_cast<Value>( static_cast<float>(val) ); }
+
+  /// Store the samples [begin, ChunkSize) of the arrays.
+  void encode(const Time* x, const Value* y, size_t begin)
+  {
+    _begin = begin;
+    _x_first = x[begin];
+    _period = (ChunkSize-1 > begin) ? (x[ChunkSize-1] - _x_first) / Time(ChunkSize-1-begin) : Time(0);
+
+    // the period is used if it is as accurate as the offsets would be
+    bool regular = (_period >= 0);
+    for (size_t i = begin; i < ChunkSize && regular; i++)
+    {
+      const Time offset = x[i] - _x_first;
+      const Time error = Time(i-begin) * _period - offset;
+      regular = ( std::abs( double(error) ) <= std::abs( double(offset) ) * std::numeric_limits<float>::epsilon() );
+    }
+    _x_offset.reset();
+    if( !regular )
+    {
+      _x_offset.reset( new float[ChunkSize] );
+      for (size_t i = begin; i < ChunkSize; i++){
+        _x_offset[i] = static_cast<float>( x[i] - _x_first );
+      }
+    }
+    for (size_t i = begin; i < ChunkSize; i++){
+      _y[i] = static_cast<float>( y[i] );
+    }
+  }
+
+  /// Inverse of encode().
+  void decode(Time* x, Value* y) const
+  {
+    for (size_t i = _begin; i < ChunkSize; i++)
+    {
+      x[i] = this->x(i);
+      y[i] = this->y(i);
+    }
+  }
+
+  Time x(size_t index) const
+  {
+    return _x_offset ? _x_first + Time(_x_offset[index]) :
+                       _x_first + Time(index - _begin) * _period;
+  }
+
+  Value y(size_t index) const { return static_cast<Value>( _y[index] ); }
+
+private:
+  Time _x_first;
+  Time _period;
+  size_t _begin;
+  std::unique_ptr<float[]> _x_offset;
+  float _y[ChunkSize];
+};
+
 template <typename Time, typename Value> class PlotDataGeneric
 {
 public:
@@ -49,16 +473,130 @@ public:
 
   enum{
     MAX_CAPACITY = 1024*1024,
-    ASYNC_BUFFER_CAPACITY = 1024
+    ASYNC_BUFFER_CAPACITY = 1024,
+    CHUNK_SIZE = 512,  // must be a power of two
+    CACHE_LINE = 64
   };
 
   typedef Time    TimeType;
 
   typedef Value   ValueType;
 
-  typedef typename std::deque<Point>::iterator Iterator;
+  /**
+   * Samples are stored in fixed size blocks; each one keeps timestamps and values
+   * in two separate, cache-aligned arrays (structure of arrays), so that
+   * scans over a range can run on contiguous memory.
+   */
+  struct Chunk
+  {
+    alignas(CACHE_LINE) Time  x[CHUNK_SIZE];
+    alignas(CACHE_LINE) Value y[CHUNK_SIZE];
+
+    // the default operator new doesn't respect over-aligned types before C++17
+    static void* operator new(size_t size)
+    {
+      void* raw = std::malloc( size + CACHE_LINE );
+      if( !raw ){
+        throw std::bad_alloc();
+      }
+      uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + CACHE_LINE) & ~uintptr_t(CACHE_LINE-1);
+      reinterpret_cast<void**>(aligned)[-1] = raw;
+      return reinterpret_cast<void*>(aligned);
+    }
+
+    static void operator delete(void* ptr)
+    {
+      if( ptr ){
+        std::free( reinterpret_cast<void**>(ptr)[-1] );
+      }
+    }
+  };
+
+  /// Reference to a sample stored inside a Chunk. Behaves like Point&.
+  class PointRef{
+  public:
+    Time& x;
+    Value& y;
+    PointRef(Time& _x, Value& _y): x(_x), y(_y) {}
+    PointRef(const PointRef& other) = default;
+
+    PointRef& operator = (const Point& p)  { x = p.x; y = p.y; return *this; }
+    PointRef& operator = (const PointRef& p) { x = p.x; y = p.y; return *this; }
+
+    operator Point() const { return Point(x,y); }
+  };
+
+  /// Reference to a sample stored inside a Chunk. Behaves like const Point&.
+  /// Numbers are held by value, since a CompactChunk doesn't store them as Time and Value.
+  class ConstPointRef{
+  public:
+    typedef typename std::conditional<std::is_arithmetic<Value>::value, const Value, const Value&>::type ValueField;
+    const Time x;
+    ValueField y;
+    ConstPointRef(const Time& _x, const Value& _y): x(_x), y(_y) {}
+    ConstPointRef(const PointRef& p): x(p.x), y(p.y) {}
+
+    operator Point() const { return Point(x,y); }
+  };
+
+  template <bool IsConst> class IteratorT
+  {
+  public:
+    typedef typename std::conditional<IsConst, const PlotDataGeneric*, PlotDataGeneric*>::type OwnerPtr;
+    typedef typename std::conditional<IsConst, ConstPointRef, PointRef>::type Reference;
+
+    struct ArrowProxy{
+      Reference ref;
+      const Reference* operator->() const { return &ref; }
+    };
+
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef Point           value_type;
+    typedef std::ptrdiff_t  difference_type;
+    typedef Reference       reference;
+    typedef ArrowProxy      pointer;
+
+    IteratorT(): _owner(nullptr), _index(0) {}
+    IteratorT(OwnerPtr owner, size_t index): _owner(owner), _index(index) {}
+
+    // Iterator -> ConstIterator
+    template <bool C, typename = typename std::enable_if<IsConst && !C>::type>
+    IteratorT(const IteratorT<C>& other): _owner(other._owner), _index(other._index) {}
+
+    Reference operator*() const  { return _owner->at(_index); }
+    ArrowProxy operator->() const { return ArrowProxy{ _owner->at(_index) }; }
+    Reference operator[](difference_type n) const { return _owner->at(_index + n); }
+
+    IteratorT& operator++()    { ++_index; return *this; }
+    IteratorT& operator--()    { --_index; return *this; }
+    IteratorT  operator++(int) { IteratorT tmp(*this); ++_index; return tmp; }
+    IteratorT  operator--(int) { IteratorT tmp(*this); --_index; return tmp; }
+
+    IteratorT& operator+=(difference_type n) { _index += n; return *this; }
+    IteratorT& operator-=(difference_type n) { _index -= n; return *this; }
+    IteratorT  operator+(difference_type n) const { return IteratorT(_owner, _index + n); }
+    IteratorT  operator-(difference_type n) const { return IteratorT(_owner, _index - n); }
+    difference_type operator-(const IteratorT& other) const
+    {
+      return difference_type(_index) - difference_type(other._index);
+    }
+
+    bool operator==(const IteratorT& other) const { return _index == other._index; }
+    bool operator!=(const IteratorT& other) const { return _index != other._index; }
+    bool operator< (const IteratorT& other) const { return _index <  other._index; }
+    bool operator> (const IteratorT& other) const { return _index >  other._index; }
+    bool operator<=(const IteratorT& other) const { return _index <= other._index; }
+    bool operator>=(const IteratorT& other) const { return _index >= other._index; }
+
+  private:
+    template <bool> friend class IteratorT;
+    OwnerPtr _owner;
+    size_t _index;
+  };
+
+  typedef IteratorT<false> Iterator;
 
-  typedef typename std::deque<Point>::const_iterator ConstIterator;
+  typedef IteratorT<true> ConstIterator;
 
   PlotDataGeneric(const std::string& name);
 
@@ -67,35 +605,76 @@ public:
   PlotDataGeneric(PlotDataGeneric&& other)
   {
       _name = std::move(other._name);
-      _points = std::move(other._points);
+      _chunks = std::move(other._chunks);
+      _spare_chunks = std::move(other._spare_chunks);
+      _max_chunks = other._max_chunks;
+      _compact = other._compact;
+      _front = other._front;
+      _size = other._size;
+      _summary = std::move(other._summary);
       _color_hint = std::move(other._color_hint);
       _max_range_X = other._max_range_X;
+      _generation = other._generation;
+      _removed = other._removed;
+      other._chunks.clear();
+      other._front = 0;
+      other._size = 0;
+      other._summary.reset(0);
   }
 
   void swapData( PlotDataGeneric<Time,Value>& other)
   {
-      std::swap(_points, other._points);
+      std::swap(_chunks, other._chunks);
+      std::swap(_spare_chunks, other._spare_chunks);
+      std::swap(_front, other._front);
+      std::swap(_size, other._size);
+      std::swap(_summary, other._summary);
+      std::swap(_removed, other._removed);
+      _generation++;
+      other._generation++;
   }
 
   PlotDataGeneric& operator = (const PlotDataGeneric<Time,Value>& other) = delete;
 
+  /**
+   * Copy that shares the blocks of samples with this series; its cost is
+   * proportional to the number of blocks, not of samples. The snapshot can be
+   * read by other threads (const methods only) while this series is modified:
+   * samples added later aren't visible to it, and the blocks it refers to are
+   * copied before being modified (copy-on-write).
+   */
+  PlotDataGeneric snapshot() const;
+
   virtual ~PlotDataGeneric() {}
 
   const std::string& name() const { return _name; }
 
   virtual size_t size() const;
 
+  /**
+   * Incremented by every modification of the samples. Comparing it with the
+   * value read earlier is the cheapest way to know if the series has changed.
+   */
+  uint64_t generation() const { return _generation; }
+
+  /**
+   * Number of samples removed from the front (popFront(), maximumRangeX(), clear())
+   * since the series was created: index + removedCount() keeps identifying the
+   * same sample when the oldest ones are removed.
+   */
+  uint64_t removedCount() const { return _removed; }
+
   int getIndexFromX(Time x) const;
 
   nonstd::optional<Value> getYfromX(Time x ) const;
 
-  const Point &at(size_t index) const;
+  ConstPointRef at(size_t index) const;
 
-  Point &at(size_t index);
+  PointRef at(size_t index);
 
-  const Point& operator[](size_t index) const { return at(index); }
+  ConstPointRef operator[](size_t index) const { return at(index); }
 
-  Point& operator[](size_t index) { return at(index); }
+  PointRef operator[](size_t index) { return at(index); }
 
   void clear();
 
@@ -109,29 +688,193 @@ public:
 
   Time maximumRangeX() const { return _max_range_X; }
 
-  const Point& front() const { return _points.front(); }
+  /**
+   * Maximum memory used by the samples, when maximumRangeX() is finite (0 means no limit).
+   * In that case the series behaves like a ring buffer: once the budget is reached,
+   * the blocks holding the oldest samples are overwritten and nothing is allocated.
+   * The blocks removed are kept for reuse, up to the same budget.
+   */
+  void setMemoryBudget(size_t bytes);
+
+  size_t memoryBudget() const { return _max_chunks * sizeof(Chunk); }
+
+  /**
+   * Opt-in storage with reduced precision: values are stored as float and
+   * timestamps, when they are regular, as a period. It takes from 1/4 to 1/2 of
+   * the memory. Only the blocks of samples that are full are compacted; they are
+   * decoded on the fly by the accessors. Available only when Value is a number.
+   */
+  void setCompactStorage(bool enable);
+
+  bool isCompactStorage() const { return _compact; }
+
+  ConstPointRef front() const { return at(0); }
+
+  ConstPointRef back() const { return at(_size-1); }
+
+  ConstIterator begin() const { return ConstIterator(this, 0); }
 
-  const Point& back() const { return _points.back(); }
+  ConstIterator end() const { return ConstIterator(this, _size); }
 
-  ConstIterator begin() const { return _points.begin(); }
+  Iterator begin() { return Iterator(this, 0); }
 
-  ConstIterator end() const { return _points.end(); }
+  Iterator end() { return Iterator(this, _size); }
 
-  Iterator begin() { return _points.begin(); }
+  void resize(size_t new_size);
 
-  Iterator end() { return _points.end(); }
+  /// Make room for count samples in total, that can then be appended without reallocations.
+  void reserve(size_t count);
 
-  void resize(size_t new_size) { _points.resize(new_size); }
+  /// Remove the first count samples.
+  void popFront(size_t count = 1);
 
-  void popFront() { _points.pop_front(); }
+  /**
+   * Move all the samples of other at the back of this series; other is left empty.
+   * When the two series are aligned, i.e. the first sample of other has the same
+   * offset inside its chunk as the end of this series, whole chunks are moved
+   * without copying. other is left aligned for the next call, therefore a
+   * buffer that is repeatedly filled and spliced is copied only once per chunk.
+   */
+  void spliceBack(PlotDataGeneric& other);
+
+  /// Index of the first sample with timestamp not lower than x (size() if none).
+  size_t lowerBound(Time x) const;
+
+  /**
+   * Lookup by timestamp that remembers the position of the previous query.
+   * The search gallops from there, therefore a sequence of increasing (or
+   * slowly changing) timestamps costs O(log distance) per query instead of
+   * O(log size). Results are the same as the methods of PlotDataGeneric with the same
+   * name; the remembered position is only a hint, so the cursor stays usable
+   * while samples are added or removed. It is stored as index + removedCount(),
+   * therefore it doesn't move when the oldest samples are removed.
+   */
+  class IndexCursor
+  {
+  public:
+    explicit IndexCursor(const PlotDataGeneric* data): _data(data), _index(0) {}
+
+    size_t lowerBound(Time x);
+
+    int getIndexFromX(Time x);
+
+    nonstd::optional<Value> getYfromX(Time x);
+
+    /// Same as PlotDataGeneric::sampleAt(), starting from the remembered position.
+    void sampleAt(const Time* x, size_t count, Value* y, const Value& default_value);
+
+  private:
+    const PlotDataGeneric* _data;
+    uint64_t _index;
+  };
+
+  /**
+   * Sample this series at the increasing timestamps x[0], ..., x[count-1]:
+   * y[i] is the value that getYfromX(x[i]) would return, or default_value
+   * if this series is empty. The two sequences are scanned once, like in a
+   * merge join.
+   */
+  void sampleAt(const Time* x, size_t count, Value* y, const Value& default_value) const;
+
+  /**
+   * Invoke op(const Time* x, const Value* y, size_t count) once for each
+   * contiguous block of samples covering the indices [first, last).
+   * This is the preferred way to scan a range of the series.
+   */
+  template <typename Op>
+  void forEachSpan(size_t first, size_t last, Op&& op) const;
+
+  /**
+   * Minimum and maximum value in the indices [first, last). It uses the
+   * per-chunk summary, therefore the complexity is logarithmic.
+   * Available only when Value is a number.
+   */
+  RangeValueOpt getRangeY(size_t first, size_t last) const;
 
 protected:
 
   std::string _name;
-  std::deque<Point> _points;
   QColor _color_hint;
 
 private:
+
+  void appendPoint(Point& point);
+
+  void trimFront();
+
+  void rebuildSummary() const;
+
+  bool isRingBuffer() const
+  {
+    return _max_chunks != 0 && _max_range_X < std::numeric_limits<Time>::max();
+  }
+
+  std::shared_ptr<Chunk> newChunk();
+
+  void recycleChunk(std::shared_ptr<Chunk> chunk);
+
+  typedef CompactChunk<Time, Value, CHUNK_SIZE> Compact;
+
+  // Exactly one of the two is set. The last chunk is never compact.
+  // Chunks may be shared with snapshots: see isShared() before modifying one.
+  struct ChunkSlot{
+    std::shared_ptr<Chunk> data;
+    std::shared_ptr<const Compact> compact;
+  };
+
+  // True if a snapshot (possibly used by another thread) refers to the chunk.
+  static bool isShared(const std::shared_ptr<Chunk>& chunk)
+  {
+    if( chunk.use_count() > 1 ){
+      return true;
+    }
+    // pairs with the release of the last reference by the other thread
+    std::atomic_thread_fence( std::memory_order_acquire );
+    return false;
+  }
+
+  // Copy-on-write: make the chunk at index a private, uncompressed one.
+  void makeWritable(size_t index);
+
+  void buildSummary(std::true_type) const
+  {
+    if( _summary.isDirty() ){
+      rebuildSummary();
+    }
+  }
+  void buildSummary(std::false_type) const {}
+
+  ChunkSlot makeSlot() { return ChunkSlot{ newChunk(), nullptr }; }
+
+  void compactChunks(size_t first, size_t last);
+
+  void expandChunk(size_t index);
+
+  Time chunkX(size_t index, size_t offset) const
+  {
+    const ChunkSlot& slot = _chunks[index];
+    return slot.data ? slot.data->x[offset] : slot.compact->x(offset);
+  }
+
+  Time timeAt(size_t index) const
+  {
+    const size_t pos = _front + index;
+    return chunkX( pos / CHUNK_SIZE, pos % CHUNK_SIZE );
+  }
+
+  // index of the sample nearest to x, given the result of lowerBound(x)
+  int nearestIndex(size_t lower_bound, Time x) const;
+
+  ChunkQueue<ChunkSlot> _chunks;
+  std::vector<std::shared_ptr<Chunk>> _spare_chunks;
+  size_t _max_chunks = 0;
+  bool _compact = false;
+  size_t _front = 0; // position of the first sample inside _chunks.front(). Empty series may
+                     // keep it different from zero, to stay aligned with a spliceBack() destination
+  size_t _size = 0;
+  uint64_t _generation = 0;
+  uint64_t _removed = 0;
+  mutable ChunkRangeSummary<Value, CHUNK_SIZE> _summary;
   Time _max_range_X;
 };
 
@@ -140,10 +883,81 @@ typedef PlotDataGeneric<double,double>  PlotData;
 typedef PlotDataGeneric<double, nonstd::any> PlotDataAny;
 
 
-typedef struct{
+struct PlotDataMapRef
+{
   std::unordered_map<std::string, PlotData>     numeric;
   std::unordered_map<std::string, PlotDataAny>  user_defined;
 
+  PlotDataMapRef() = default;
+
+  // the cached handles point inside this map: it can be moved, but not copied.
+  PlotDataMapRef(const PlotDataMapRef&) = delete;
+  PlotDataMapRef& operator=(const PlotDataMapRef&) = delete;
+  PlotDataMapRef(PlotDataMapRef&&) = default;
+  PlotDataMapRef& operator=(PlotDataMapRef&&) = default;
+
+  /// Incremented every time a timeseries is removed, i.e. when pointers to the
+  /// elements of numeric and user_defined might be invalidated.
+  /// Timeseries must be removed using eraseNumeric() and clear().
+  size_t erase_count = 0;
+
+  /**
+   * Integer handle of a name. Names are interned: the handle is resolved once and
+   * never changes, even if the timeseries is removed and added again.
+   * Use it with numericByID() and userDefinedByID() to avoid hashing the name again.
+   */
+  typedef uint32_t SeriesID;
+
+  SeriesID getID(const std::string& name) const
+  {
+      auto it = _series_ids.find( name );
+      if( it == _series_ids.end() )
+      {
+          it = _series_ids.insert( { name, SeriesID(_series_handles.size()) } ).first;
+          _series_handles.push_back( { &it->first, nullptr, nullptr } );
+      }
+      return it->second;
+  }
+
+  const std::string& getName(SeriesID id) const
+  {
+      return *_series_handles[id].name;
+  }
+
+  /// nullptr if there isn't any numeric timeseries with that name.
+  PlotData* numericByID(SeriesID id)
+  {
+      SeriesHandle& handle = validHandle( id );
+      if( !handle.numeric )
+      {
+          auto it = numeric.find( *handle.name );
+          handle.numeric = (it == numeric.end()) ? nullptr : &it->second;
+      }
+      return handle.numeric;
+  }
+
+  const PlotData* numericByID(SeriesID id) const
+  {
+      return const_cast<PlotDataMapRef*>(this)->numericByID( id );
+  }
+
+  /// nullptr if there isn't any user defined timeseries with that name.
+  PlotDataAny* userDefinedByID(SeriesID id)
+  {
+      SeriesHandle& handle = validHandle( id );
+      if( !handle.user_defined )
+      {
+          auto it = user_defined.find( *handle.name );
+          handle.user_defined = (it == user_defined.end()) ? nullptr : &it->second;
+      }
+      return handle.user_defined;
+  }
+
+  const PlotDataAny* userDefinedByID(SeriesID id) const
+  {
+      return const_cast<PlotDataMapRef*>(this)->userDefinedByID( id );
+  }
+
   std::unordered_map<std::string, PlotData>::iterator addNumeric(const std::string& name)
   {
       return numeric.emplace( std::piecewise_construct,
@@ -153,16 +967,123 @@ typedef struct{
   }
 
 
-  std::unordered_map<std::string, PlotDataAny>::iterator addUserDefined(const std::string& name)
+  std::unordered_map<std::string, PlotDataAny>::iterator addUserDefined(const std::string& name)
+  {
+      return user_defined.emplace( std::piecewise_construct,
+                                   std::forward_as_tuple(name),
+                                   std::forward_as_tuple(name)
+                                   ).first;
+  }
+
+  void eraseNumeric(std::unordered_map<std::string, PlotData>::iterator it)
+  {
+      numeric.erase( it );
+      erase_count++;
+  }
+
+  void clear()
+  {
+      numeric.clear();
+      user_defined.clear();
+      erase_count++;
+  }
+
+  /**
+   * Copy of all the timeseries, sharing the samples with this map (see
+   * PlotDataGeneric::snapshot()). Other threads can read it while this map is
+   * modified; they must look the series up by name, because the cache used by
+   * getID() and numericByID() is not thread-safe.
+   */
+  PlotDataMapRef snapshot() const
+  {
+      PlotDataMapRef copy;
+      copy.numeric.reserve( numeric.size() );
+      for (const auto& it: numeric)
+      {
+          copy.numeric.emplace( it.first, it.second.snapshot() );
+      }
+      copy.user_defined.reserve( user_defined.size() );
+      for (const auto& it: user_defined)
+      {
+          copy.user_defined.emplace( it.first, it.second.snapshot() );
+      }
+      return copy;
+  }
+
+private:
+
+  // The pointers are cached when a series is found; all of them are dropped
+  // when erase_count changes.
+  struct SeriesHandle{
+    const std::string* name;
+    PlotData* numeric;
+    PlotDataAny* user_defined;
+  };
+
+  SeriesHandle& validHandle(SeriesID id)
+  {
+      if( _handles_erase_count != erase_count )
+      {
+          for (auto& handle: _series_handles)
+          {
+              handle.numeric = nullptr;
+              handle.user_defined = nullptr;
+          }
+          _handles_erase_count = erase_count;
+      }
+      return _series_handles[id];
+  }
+
+  // Interning doesn't modify the timeseries, therefore it is allowed on a const map.
+  // Like the rest of the map, it is not thread-safe.
+  mutable std::unordered_map<std::string, SeriesID> _series_ids;
+  mutable std::vector<SeriesHandle> _series_handles;
+  mutable size_t _handles_erase_count = 0;
+};
+
+
+/**
+ * Read-copy-update of a PlotDataMapRef. The thread that owns the map publishes
+ * snapshots of it, which other threads read without any lock: a snapshot
+ * never changes, and it is released when the last reader drops it.
+ *
+ * Snapshots are published on demand: latest() returns the last one and asks
+ * the owner for a new one, see wanted().
+ */
+class PlotDataMapPublisher
+{
+public:
+  struct Snapshot
+  {
+    uint64_t epoch; // incremented at every publication
+    PlotDataMapRef data;
+  };
+
+  typedef std::shared_ptr<const Snapshot> SnapshotPtr;
+
+  /// Reader side, any thread. nullptr if nothing has been published yet.
+  SnapshotPtr latest() const
+  {
+      _wanted.store( true, std::memory_order_relaxed );
+      return std::atomic_load( &_latest );
+  }
+
+  /// Owner side: true if a reader asked for a snapshot after the last publish().
+  bool wanted() const { return _wanted.load( std::memory_order_relaxed ); }
+
+  /// Owner side, in the thread that modifies the map.
+  void publish(const PlotDataMapRef& data)
   {
-      return user_defined.emplace( std::piecewise_construct,
-                                   std::forward_as_tuple(name),
-                                   std::forward_as_tuple(name)
-                                   ).first;
+      _wanted.store( false, std::memory_order_relaxed );
+      SnapshotPtr snapshot( new Snapshot{ ++_epoch, data.snapshot() } );
+      std::atomic_store( &_latest, std::move(snapshot) );
   }
 
-} PlotDataMapRef;
-
+private:
+  SnapshotPtr _latest;
+  mutable std::atomic<bool> _wanted{false};
+  uint64_t _epoch = 0;
+};
 
 //-----------------------------------
 template<typename Value>
@@ -208,20 +1129,64 @@ inline PlotDataGeneric<Time, Value>::PlotDataGeneric(const std::string &name):
     , _name(name)
 {
     static_assert( std::is_arithmetic<Time>::value ,"Only numbers can be used as time");
+    static_assert( (CHUNK_SIZE & (CHUNK_SIZE-1)) == 0 ,"CHUNK_SIZE must be a power of two");
 }
 
 template < typename Time, typename Value>
-inline void PlotDataGeneric<Time, Value>::pushBack(Point point)
+inline void PlotDataGeneric<Time, Value>::appendPoint(Point& point)
 {
-  _points.push_back( point );
+  const size_t pos = _front + _size;
+  if( pos == _chunks.size() * CHUNK_SIZE || _chunks.empty() )
+  {
+    if( _compact && !_chunks.empty() )
+    {
+      compactChunks( _chunks.size()-1, _chunks.size() );
+    }
+    _chunks.push_back( makeSlot() );
+    _summary.pushChunk( _chunks.size() );
+  }
+  Chunk& chunk = *_chunks.back().data;
+  chunk.x[ pos % CHUNK_SIZE ] = point.x;
+  chunk.y[ pos % CHUNK_SIZE ] = std::move(point.y);
+  _summary.extend( _chunks.size()-1, pos % CHUNK_SIZE, chunk.y[ pos % CHUNK_SIZE ] );
+  _size++;
+  _generation++;
+}
 
-  while( _points.size()>2 &&
-         (_points.back().x - _points.front().x) > _max_range_X)
+template < typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::trimFront()
+{
+  if( isRingBuffer() )
+  {
+    // the chunk just added at the back reuses the one removed here
+    while( _chunks.size() > _max_chunks )
+    {
+      popFront( CHUNK_SIZE - _front );
+    }
+  }
+  if( _size <= 2 || (back().x - front().x) <= _max_range_X )
+  {
+    return;
+  }
+  // drop the old samples all at once, then fix the boundary one by one
+  const size_t first = lowerBound( back().x - _max_range_X );
+  if( first > 1 )
+  {
+    popFront( std::min( first-1, _size-2 ) );
+  }
+  while( _size>2 && (back().x - front().x) > _max_range_X)
   {
-        _points.pop_front();
+    popFront();
   }
 }
 
+template < typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::pushBack(Point point)
+{
+  appendPoint( point );
+  trimFront();
+}
+
 template <> // template specialization
 inline void PlotDataGeneric<double, double>::pushBack(Point point)
 {
@@ -229,38 +1194,183 @@ inline void PlotDataGeneric<double, double>::pushBack(Point point)
     {
         return; // skip
     }
-    _points.push_back( point );
+    appendPoint( point );
+    trimFront();
+}
+
+template < typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::popFront(size_t count)
+{
+  if( count >= _size )
+  {
+    clear();
+    return;
+  }
+  _size  -= count;
+  _front += count;
+  _removed += count;
+  _generation++;
+  while( _front >= CHUNK_SIZE )
+  {
+    recycleChunk( std::move( _chunks.front().data ) );
+    _chunks.pop_front();
+    _summary.popChunk();
+    _front -= CHUNK_SIZE;
+  }
+}
+
+template < typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::spliceBack(PlotDataGeneric& other)
+{
+  if( other._size == 0 )
+  {
+    return;
+  }
+
+  const size_t first_chunk = (_size == 0) ? 0 : _chunks.size()-1;
+
+  if( _size == 0 )
+  {
+    std::swap( _chunks, other._chunks );
+    std::swap( _summary, other._summary );
+    _front = other._front;
+    _size  = other._size;
+    _generation++;
+  }
+  else if( (_front + _size) % CHUNK_SIZE == other._front )
+  {
+    size_t src_chunk = 0;
+    if( other._front != 0 )
+    {
+      // the first chunk of other completes our last one
+      other.makeWritable( 0 );
+      Chunk& dst = *_chunks.back().data;
+      Chunk& src = *other._chunks.front().data;
+      const size_t end = std::min<size_t>( CHUNK_SIZE, other._front + other._size );
+      for (size_t i = other._front; i < end; i++)
+      {
+        dst.x[i] = src.x[i];
+        dst.y[i] = std::move( src.y[i] );
+        _summary.extend( _chunks.size()-1, i, dst.y[i] );
+      }
+      src_chunk = 1;
+    }
+    if( other._summary.isDirty() )
+    {
+      _summary.setDirty();
+    }
+    for (; src_chunk < other._chunks.size(); src_chunk++)
+    {
+      _chunks.push_back( std::move( other._chunks[src_chunk] ) );
+      _summary.pushChunk( _chunks.size() );
+      _summary.copyChunk( _chunks.size()-1, other._summary, src_chunk );
+    }
+    _size += other._size;
+    _generation++;
+  }
+  else{
+    for (size_t i = 0; i < other._size; i++)
+    {
+      const size_t pos = other._front + i;
+      if( i == 0 || pos % CHUNK_SIZE == 0 )
+      {
+        other.makeWritable( pos / CHUNK_SIZE );
+      }
+      Chunk& src = *other._chunks[ pos / CHUNK_SIZE ].data;
+      Point point( src.x[ pos % CHUNK_SIZE ], std::move( src.y[ pos % CHUNK_SIZE ] ) );
+      appendPoint( point );
+    }
+  }
+
+  if( _compact && _chunks.size() > first_chunk + 1 )
+  {
+    compactChunks( first_chunk, _chunks.size()-1 );
+  }
+  // the chunks left in other are recycled here: the pool of a ring buffer is larger
+  for (size_t c = 0; c < other._chunks.size(); c++)
+  {
+    recycleChunk( std::move( other._chunks[c].data ) );
+  }
+  other.clear();
+  trimFront();
+
+  // the chunks we don't need anymore will be filled again by other
+  while( !_spare_chunks.empty() )
+  {
+    other._spare_chunks.push_back( std::move( _spare_chunks.back() ) );
+    _spare_chunks.pop_back();
+  }
+  other._front = (_front + _size) % CHUNK_SIZE;
+}
+
+template < typename Time, typename Value>
+inline size_t PlotDataGeneric<Time, Value>::lowerBound(Time x) const
+{
+  if( _size == 0 ){
+    return 0;
+  }
+  const size_t storage_end = _front + _size;
+
+  // first find the chunk, looking at the last timestamp of each one
+  size_t lo = 0;
+  size_t hi = _chunks.size();
+  while( lo < hi )
+  {
+    const size_t mid = (lo + hi) / 2;
+    const size_t last = std::min<size_t>( (mid+1) * CHUNK_SIZE, storage_end ) - 1;
+    if( chunkX( mid, last % CHUNK_SIZE ) < x ){
+      lo = mid + 1;
+    }
+    else{
+      hi = mid;
+    }
+  }
+  if( lo == _chunks.size() ){
+    return _size;
+  }
 
-    while( _points.size()>2 &&
-           (_points.back().x - _points.front().x) > _max_range_X)
+  // then search the timestamps of that chunk
+  size_t begin = (lo == 0) ? _front : 0;
+  size_t end   = std::min<size_t>( CHUNK_SIZE, storage_end - lo * CHUNK_SIZE );
+  if( const Chunk* chunk = _chunks[lo].data.get() )
+  {
+    begin = size_t( std::lower_bound( chunk->x + begin, chunk->x + end, x ) - chunk->x );
+  }
+  else{
+    while( begin < end )
     {
-        _points.pop_front();
+      const size_t mid = (begin + end) / 2;
+      if( chunkX( lo, mid ) < x ){
+        begin = mid + 1;
+      }
+      else{
+        end = mid;
+      }
     }
+  }
+  return lo * CHUNK_SIZE + begin - _front;
 }
 
 template < typename Time, typename Value>
 inline int PlotDataGeneric<Time, Value>::getIndexFromX(Time x ) const
 {
-  if( _points.size() == 0 ){
+  if( _size == 0 ){
     return -1;
   }
-  auto lower = std::lower_bound(_points.begin(), _points.end(), Point(x,0),
-                                [](const Point &a, const Point &b)
-                                { return a.x < b.x; } );
-  auto index = std::distance( _points.begin(), lower);
+  return nearestIndex( lowerBound( x ), x );
+}
 
-  if( index >= _points.size() )
-  {
-    return _points.size() -1;
-  }
-  if( index < 0)
+template < typename Time, typename Value>
+inline int PlotDataGeneric<Time, Value>::nearestIndex(size_t index, Time x ) const
+{
+  if( index >= _size )
   {
-    return 0;
+    return _size -1;
   }
 
   if( index > 0)
   {
-    if( Abs( _points[index-1].x - x) < Abs( _points[index].x - x) )
+    if( Abs( timeAt(index-1) - x) < Abs( timeAt(index) - x) )
     {
       return index-1;
     }
@@ -271,6 +1381,101 @@ inline int PlotDataGeneric<Time, Value>::getIndexFromX(Time x ) const
   return index;
 }
 
+template < typename Time, typename Value>
+inline size_t PlotDataGeneric<Time, Value>::IndexCursor::lowerBound(Time x)
+{
+  const size_t size = _data->size();
+  const uint64_t removed = _data->removedCount();
+  size_t lo = 0;
+  size_t hi = size;
+  const size_t hint = (_index < removed) ? 0 : size_t( std::min<uint64_t>( _index - removed, size ) );
+
+  // gallop from the hint until [lo, hi] contains the result
+  if( hint < size && _data->timeAt(hint) < x )
+  {
+    lo = hint + 1;
+    for( size_t step = 1; lo + step - 1 < size; step *= 2 )
+    {
+      const size_t probe = lo + step - 1;
+      if( _data->timeAt(probe) < x ){
+        lo = probe + 1;
+      }
+      else{
+        hi = probe;
+        break;
+      }
+    }
+  }
+  else{
+    hi = hint;
+    for( size_t step = 1; step <= hi; step *= 2 )
+    {
+      const size_t probe = hi - step;
+      if( _data->timeAt(probe) < x ){
+        lo = probe + 1;
+        break;
+      }
+      hi = probe;
+    }
+  }
+
+  while( lo < hi )
+  {
+    const size_t mid = (lo + hi) / 2;
+    if( _data->timeAt(mid) < x ){
+      lo = mid + 1;
+    }
+    else{
+      hi = mid;
+    }
+  }
+  _index = lo + removed;
+  return lo;
+}
+
+template < typename Time, typename Value>
+inline int PlotDataGeneric<Time, Value>::IndexCursor::getIndexFromX(Time x)
+{
+  if( _data->size() == 0 ){
+    return -1;
+  }
+  return _data->nearestIndex( lowerBound( x ), x );
+}
+
+template < typename Time, typename Value>
+inline nonstd::optional<Value> PlotDataGeneric<Time, Value>::IndexCursor::getYfromX(Time x)
+{
+  int index = getIndexFromX( x );
+  if( index == -1 )
+  {
+    return nonstd::optional<Value>();
+  }
+  return _data->at(index).y;
+}
+
+template < typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::sampleAt(const Time* x, size_t count,
+                                                   Value* y, const Value& default_value) const
+{
+  IndexCursor cursor( this );
+  cursor.sampleAt( x, count, y, default_value );
+}
+
+template < typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::IndexCursor::sampleAt(const Time* x, size_t count,
+                                                                Value* y, const Value& default_value)
+{
+  if( _data->size() == 0 )
+  {
+    std::fill( y, y + count, default_value );
+    return;
+  }
+  for( size_t i = 0; i < count; i++ )
+  {
+    y[i] = _data->at( getIndexFromX( x[i] ) ).y;
+  }
+}
+
 
 template < typename Time, typename Value>
 inline nonstd::optional<Value> PlotDataGeneric<Time, Value>::getYfromX(Time x) const
@@ -280,34 +1485,328 @@ inline nonstd::optional<Value> PlotDataGeneric<Time, Value>::getYfromX(Time x) c
   {
     return nonstd::optional<Value>();
   }
-  return _points.at(index).y;
+  return at(index).y;
 }
 
 template < typename Time, typename Value>
-inline const typename PlotDataGeneric<Time, Value>::Point&
+inline typename PlotDataGeneric<Time, Value>::ConstPointRef
 PlotDataGeneric<Time, Value>::at(size_t index) const
 {
-    return _points[index];
+    const size_t pos = _front + index;
+    const ChunkSlot& slot = _chunks[ pos / CHUNK_SIZE ];
+    if( slot.compact )
+    {
+      return ConstPointRef( slot.compact->x( pos % CHUNK_SIZE ), slot.compact->y( pos % CHUNK_SIZE ) );
+    }
+    const Chunk& chunk = *slot.data;
+    return ConstPointRef( chunk.x[ pos % CHUNK_SIZE ], chunk.y[ pos % CHUNK_SIZE ] );
 }
 
 template < typename Time, typename Value>
-inline typename PlotDataGeneric<Time, Value>::Point&
+inline typename PlotDataGeneric<Time, Value>::PointRef
 PlotDataGeneric<Time, Value>::at(size_t index)
 {
-    return _points[index];
+    _summary.setDirty();
+    _generation++;
+    const size_t pos = _front + index;
+    makeWritable( pos / CHUNK_SIZE );
+    Chunk& chunk = *_chunks[ pos / CHUNK_SIZE ].data;
+    return PointRef( chunk.x[ pos % CHUNK_SIZE ], chunk.y[ pos % CHUNK_SIZE ] );
+}
+
+template < typename Time, typename Value> template <typename Op>
+inline void PlotDataGeneric<Time, Value>::forEachSpan(size_t first, size_t last, Op&& op) const
+{
+  size_t pos = _front + first;
+  const size_t pos_end = _front + std::min( last, _size );
+  while( pos < pos_end )
+  {
+    const size_t offset = pos % CHUNK_SIZE;
+    const size_t count = std::min<size_t>( CHUNK_SIZE - offset, pos_end - pos );
+    const ChunkSlot& slot = _chunks[ pos / CHUNK_SIZE ];
+    if( slot.compact )
+    {
+      Time  x[CHUNK_SIZE];
+      Value y[CHUNK_SIZE];
+      slot.compact->decode( x, y );
+      op( x + offset, y + offset, count );
+    }
+    else{
+      op( slot.data->x + offset, slot.data->y + offset, count );
+    }
+    pos += count;
+  }
+}
+
+template < typename Time, typename Value>
+inline typename PlotDataGeneric<Time, Value>::RangeValueOpt
+PlotDataGeneric<Time, Value>::getRangeY(size_t first, size_t last) const
+{
+  static_assert( std::is_arithmetic<Value>::value ,"getRangeY requires numeric values");
+  typedef ChunkRangeSummary<Value, CHUNK_SIZE> Summary;
+  const size_t BUCKET = Summary::LOD_BUCKET_SIZE;
+
+  last = std::min( last, _size );
+  if( first >= last )
+  {
+    return RangeValueOpt();
+  }
+  if( _summary.isDirty() )
+  {
+    rebuildSummary();
+  }
+
+  auto res = Summary::empty();
+
+  // raw samples, positions are relative to the storage (i.e. include _front)
+  auto scan = [this, &res](size_t pos_a, size_t pos_b)
+  {
+    forEachSpan( pos_a - _front, pos_b - _front, [&res](const Time*, const Value* y, size_t count)
+    {
+      for (size_t i=0; i < count; i++ )
+      {
+        res.min = std::min( res.min, y[i] );
+        res.max = std::max( res.max, y[i] );
+      }
+    });
+  };
+
+  // whole buckets, [pos_a, pos_b) must be aligned to LOD_BUCKET_SIZE
+  auto buckets = [this, &res, BUCKET](size_t pos_a, size_t pos_b)
+  {
+    while( pos_a < pos_b )
+    {
+      const size_t chunk = pos_a / CHUNK_SIZE;
+      const size_t end = std::min( pos_b, (chunk+1) * CHUNK_SIZE );
+      res = Summary::merge( res, _summary.queryBuckets( chunk,
+                                                         (pos_a % CHUNK_SIZE) / BUCKET,
+                                                         (end - chunk*CHUNK_SIZE) / BUCKET ) );
+      pos_a = end;
+    }
+  };
+
+  // The partial buckets at the two ends are scanned, the partial chunks use the
+  // buckets, everything in between uses the tree of chunks.
+  // Note that a bucket (or chunk) containing removed samples is never entirely
+  // inside the range, therefore its stale summary is never used.
+  const size_t pos     = _front + first;
+  const size_t pos_end = _front + last;
+  const size_t bucket_begin = (pos + BUCKET - 1) / BUCKET * BUCKET;
+  const size_t bucket_end   = pos_end / BUCKET * BUCKET;
+
+  if( bucket_begin >= bucket_end )
+  {
+    scan( pos, pos_end );
+    return RangeValueOpt( { res.min, res.max } );
+  }
+  scan( pos, bucket_begin );
+  scan( bucket_end, pos_end );
+
+  const size_t chunk_begin = (bucket_begin + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  const size_t chunk_end   = bucket_end / CHUNK_SIZE;
+
+  if( chunk_begin >= chunk_end )
+  {
+    buckets( bucket_begin, bucket_end );
+  }
+  else{
+    buckets( bucket_begin, chunk_begin * CHUNK_SIZE );
+    res = Summary::merge( res, _summary.queryChunks( chunk_begin, chunk_end ) );
+    buckets( chunk_end * CHUNK_SIZE, bucket_end );
+  }
+  return RangeValueOpt( { res.min, res.max } );
+}
+
+template < typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::rebuildSummary() const
+{
+  typedef ChunkRangeSummary<Value, CHUNK_SIZE> Summary;
+  const size_t BUCKET = Summary::LOD_BUCKET_SIZE;
+
+  _summary.reset( _chunks.size() );
+  for (size_t c=0; c < _chunks.size(); c++)
+  {
+    const size_t chunk_end = (c == _chunks.size()-1) ? (_front + _size) - c*CHUNK_SIZE : CHUNK_SIZE;
+    size_t offset = (c == 0) ? _front : 0;
+    while( offset < chunk_end )
+    {
+      const size_t b = offset / BUCKET;
+      const size_t end = std::min( chunk_end, (b+1)*BUCKET );
+      auto range = Summary::empty();
+      const ChunkSlot& slot = _chunks[c];
+      for (; offset < end; offset++ )
+      {
+        const Value val = slot.data ? slot.data->y[offset] : slot.compact->y(offset);
+        range.min = std::min( range.min, val );
+        range.max = std::max( range.max, val );
+      }
+      _summary.initBucket( c, b, range );
+    }
+  }
+  _summary.build();
 }
 
 template<typename Time, typename Value>
 void PlotDataGeneric<Time, Value>::clear()
 {
-    _points.clear();
+    // keep one chunk around, streamers clear their buffers at every update
+    if( !_chunks.empty() && _chunks.front().data )
+    {
+        recycleChunk( std::move( _chunks.front().data ) );
+    }
+    _chunks.clear();
+    _summary.reset(0);
+    _front = 0;
+    _removed += _size;
+    _size = 0;
+    _generation++;
+}
+
+template<typename Time, typename Value>
+void PlotDataGeneric<Time, Value>::resize(size_t new_size)
+{
+    if( new_size == 0 )
+    {
+        clear();
+        return;
+    }
+    const size_t old_size = _size;
+    const size_t chunks_count = (_front + new_size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    while( _chunks.size() > chunks_count )
+    {
+        _chunks.pop_back();
+    }
+    // the samples after the new end will be overwritten
+    if( !_chunks.empty() )
+    {
+        makeWritable( _chunks.size()-1 );
+    }
+    while( _chunks.size() < chunks_count )
+    {
+        _chunks.push_back( makeSlot() );
+    }
+    _size = new_size;
+    _summary.setDirty();
+    _generation++;
+
+    for (size_t i = old_size; i < new_size; i++)
+    {
+        at(i) = Point( Time(), Value() );
+    }
+}
+
+template<typename Time, typename Value>
+void PlotDataGeneric<Time, Value>::reserve(size_t count)
+{
+    size_t chunks_count = (_front + count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if( isRingBuffer() )
+    {
+        chunks_count = std::min( chunks_count, _max_chunks + 1 );
+    }
+    _chunks.reserve( chunks_count );
+    _summary.reserve( chunks_count );
+}
+
+template<typename Time, typename Value>
+inline std::shared_ptr<typename PlotDataGeneric<Time, Value>::Chunk>
+PlotDataGeneric<Time, Value>::newChunk()
+{
+    if( _spare_chunks.empty() )
+    {
+        return std::shared_ptr<Chunk>( new Chunk );
+    }
+    std::shared_ptr<Chunk> chunk = std::move( _spare_chunks.back() );
+    _spare_chunks.pop_back();
+    return chunk;
+}
+
+template<typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::compactChunks(size_t first, size_t last)
+{
+    for (size_t c = first; c < last; c++)
+    {
+        ChunkSlot& slot = _chunks[c];
+        if( !slot.data ){
+            continue;
+        }
+        std::shared_ptr<Compact> compact( new Compact );
+        compact->encode( slot.data->x, slot.data->y, (c == 0) ? _front : 0 );
+        slot.compact = std::move( compact );
+        _summary.transformChunk( c, [](const Value& val) { return Compact::round(val); } );
+        recycleChunk( std::move(slot.data) );
+    }
+}
+
+template<typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::expandChunk(size_t index)
+{
+    ChunkSlot& slot = _chunks[index];
+    slot.data = newChunk();
+    slot.compact->decode( slot.data->x, slot.data->y );
+    slot.compact.reset();
+}
+
+template<typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::makeWritable(size_t index)
+{
+    ChunkSlot& slot = _chunks[index];
+    if( slot.compact )
+    {
+        expandChunk( index );
+    }
+    else if( isShared( slot.data ) )
+    {
+        std::shared_ptr<Chunk> chunk = newChunk();
+        *chunk = *slot.data;
+        slot.data = std::move( chunk );
+    }
+}
+
+template<typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::recycleChunk(std::shared_ptr<Chunk> chunk)
+{
+    // a chunk still used by a snapshot is released by the snapshot itself
+    if( !chunk || isShared( chunk ) ){
+        return;
+    }
+    // A ring buffer keeps the chunks for the samples that will replace the removed ones;
+    // they are also handed over to the series given to spliceBack().
+    const size_t max_spare = isRingBuffer() ? _max_chunks : 1;
+    if( _spare_chunks.size() < max_spare )
+    {
+        _spare_chunks.push_back( std::move(chunk) );
+    }
 }
 
+template < typename Time, typename Value>
+inline PlotDataGeneric<Time, Value> PlotDataGeneric<Time, Value>::snapshot() const
+{
+    // built here, otherwise the readers would build it lazily, concurrently
+    buildSummary( std::is_arithmetic<Value>() );
+
+    PlotDataGeneric copy( _name );
+    copy._chunks.reserve( _chunks.size() );
+    for (size_t c = 0; c < _chunks.size(); c++)
+    {
+        ChunkSlot slot = _chunks[c];
+        copy._chunks.push_back( std::move(slot) );
+    }
+    copy._compact = _compact;
+    copy._front = _front;
+    copy._size = _size;
+    copy._summary = _summary;
+    copy._color_hint = _color_hint;
+    copy._max_range_X = _max_range_X;
+    copy._generation = _generation;
+    copy._removed = _removed;
+    return copy;
+}
 
 template < typename Time, typename Value>
 inline size_t PlotDataGeneric<Time, Value>::size() const
 {
-  return _points.size();
+  return _size;
 }
 
 template < typename Time, typename Value>
@@ -327,11 +1826,38 @@ template < typename Time, typename Value>
 inline void PlotDataGeneric<Time, Value>::setMaximumRangeX(Time max_range)
 {
   _max_range_X = max_range;
-  while( _points.size()>2 &&
-         _points.back().x - _points.front().x > _max_range_X)
+  trimFront();
+}
+
+template < typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::setCompactStorage(bool enable)
+{
+  _compact = enable && Compact::isSupported();
+  if( _chunks.empty() )
+  {
+    return;
+  }
+  if( _compact )
   {
-        _points.pop_front();
+    // the values are rounded
+    compactChunks( 0, _chunks.size()-1 );
+    _generation++;
+  }
+  else{
+    for (size_t c = 0; c < _chunks.size(); c++)
+    {
+      if( _chunks[c].compact ){
+        expandChunk( c );
+      }
+    }
   }
 }
 
+template < typename Time, typename Value>
+inline void PlotDataGeneric<Time, Value>::setMemoryBudget(size_t bytes)
+{
+  _max_chunks = (bytes == 0) ? 0 : std::max<size_t>( 2, bytes / sizeof(Chunk) );
+  trimFront();
+}
+
 #endif // PLOTDATA_H
@@ -19,6 +19,9 @@ public:
 
     std::vector<int> getSelectedRowNumber() const;
 
+    /// Add a widget between the list and the buttons, e.g. with the options of the selection.
+    void addOptionsWidget(QWidget* widget);
+
 private slots:
     void on_buttonBox_accepted();
 
@@ -77,6 +80,11 @@ inline std::vector<int> SelectFromListDialog::getSelectedRowNumber() const
     return _selected_row_number;
 }
 
+inline void SelectFromListDialog::addOptionsWidget(QWidget* widget)
+{
+    ui->verticalLayout->insertWidget( 1, widget );
+}
+
 inline void SelectFromListDialog::on_listFieldsWidget_clicked(const QModelIndex &index)
 {
     QModelIndexList indexes = ui->listFieldsWidget->selectionModel()->selectedIndexes();
@@ -0,0 +1,88 @@
+#ifndef PJ_SPSC_QUEUE_H
+#define PJ_SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Bounded, lock-free queue with a Single Producer and a Single Consumer.
+ *
+ * push() must be called by only one thread and pop() by only one (other) thread.
+ * The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class SPSCQueue
+{
+public:
+
+    explicit SPSCQueue(size_t capacity = 64)
+    {
+        size_t size = 2;
+        while( size < capacity ){
+            size *= 2;
+        }
+        _buffer.resize( size );
+        _mask = size - 1;
+    }
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator = (const SPSCQueue&) = delete;
+
+    /// Producer side. Returns false (and leaves item untouched) if the queue is full.
+    bool push(T&& item)
+    {
+        const size_t tail = _tail.load( std::memory_order_relaxed );
+        if( tail - _cached_head > _mask )
+        {
+            _cached_head = _head.load( std::memory_order_acquire );
+            if( tail - _cached_head > _mask ){
+                return false;
+            }
+        }
+        _buffer[ tail & _mask ] = std::move(item);
+        _tail.store( tail + 1, std::memory_order_release );
+        return true;
+    }
+
+    /// Consumer side. Returns false if the queue is empty.
+    bool pop(T& item)
+    {
+        const size_t head = _head.load( std::memory_order_relaxed );
+        if( head == _cached_tail )
+        {
+            _cached_tail = _tail.load( std::memory_order_acquire );
+            if( head == _cached_tail ){
+                return false;
+            }
+        }
+        item = std::move( _buffer[ head & _mask ] );
+        _head.store( head + 1, std::memory_order_release );
+        return true;
+    }
+
+    /// Approximated when called concurrently with push() or pop().
+    bool empty() const
+    {
+        return _head.load( std::memory_order_acquire ) == _tail.load( std::memory_order_acquire );
+    }
+
+private:
+    // producer and consumer data are kept on separate cache lines
+    enum{ CACHE_LINE = 64 };
+
+    std::vector<T> _buffer;
+    size_t _mask;
+
+    char _pad0[CACHE_LINE];
+    std::atomic<size_t> _head{0}; // written by the consumer
+    size_t _cached_tail = 0;      // consumer's copy of _tail
+
+    char _pad1[CACHE_LINE];
+    std::atomic<size_t> _tail{0}; // written by the producer
+    size_t _cached_head = 0;      // producer's copy of _head
+
+    char _pad2[CACHE_LINE];
+};
+
+#endif // PJ_SPSC_QUEUE_H
@@ -102,7 +102,7 @@ void CurveListPanel::clear()
     _table_view->clear();
     _custom_view->clear();
     _tree_view->clear();
-    _numeric_data = nullptr;
+    _plot_data = nullptr;
     ui->labelNumberDisplayed->setText("0 of 0");
 }
 
@@ -154,17 +154,17 @@ bool CurveListPanel::is2ndColumnHidden() const
 }
 
 void CurveListPanel::update2ndColumnValues(double tracker_time,
-                                           std::unordered_map<std::string, PlotData> *numeric_data)
+                                           PlotDataMapRef *plot_data)
 {
     _tracker_time = tracker_time;
-    _numeric_data = numeric_data;
+    _plot_data = plot_data;
 
     refreshValues();
 }
 
 void CurveListPanel::refreshValues()
 {
-    if( is2ndColumnHidden() || !_numeric_data ){
+    if( is2ndColumnHidden() || !_plot_data ){
         return;
     }
 
@@ -184,12 +184,14 @@ void CurveListPanel::refreshValues()
         return num_text + " ";
     };
 
-    auto GetValue = [&](const std::string& name) -> nonstd::optional<double>
+    // the SeriesID of a curve is cached in its item, to avoid a lookup by name
+    const int ID_ROLE = Qt::UserRole + 1;
+
+    auto GetValue = [&](PlotDataMapRef::SeriesID id) -> nonstd::optional<double>
     {
-        auto it = _numeric_data->find(name);
-        if( it !=  _numeric_data->end())
+        if( const PlotData* data_ptr = _plot_data->numericByID(id) )
         {
-            auto& data = it->second;
+            auto& data = *data_ptr;
 
             if( _tracker_time < std::numeric_limits<double>::max())
             {
@@ -218,8 +220,14 @@ void CurveListPanel::refreshValues()
             if( vertical_pos < 0 || table->isRowHidden(row) ){ continue; }
             if( vertical_pos > vertical_height){ break; }
 
-            const std::string& name = table->item(row,0)->text().toStdString();
-            auto val = GetValue(name);
+            QTableWidgetItem* name_item = table->item(row,0);
+            QVariant id = name_item->data( ID_ROLE );
+            if( !id.isValid() )
+            {
+                id = _plot_data->getID( name_item->text().toStdString() );
+                name_item->setData( ID_ROLE, id );
+            }
+            auto val = GetValue( id.toUInt() );
             if (val)
             {
                 table->item(row, 1)->setText(FormattedNumber( val.value() ));
@@ -242,7 +250,13 @@ void CurveListPanel::refreshValues()
                 if( rect.bottom() < 0 || cell->isHidden() ){ return; }
                 if( rect.top() > vertical_height){ return; }
 
-                auto val = GetValue( curve_name.toStdString() );
+                QVariant id = cell->data( 0, ID_ROLE );
+                if( !id.isValid() )
+                {
+                    id = _plot_data->getID( curve_name.toStdString() );
+                    cell->setData( 0, ID_ROLE, id );
+                }
+                auto val = GetValue( id.toUInt() );
                 if (val)
                 {
                     cell->setText(1, FormattedNumber( val.value() ));
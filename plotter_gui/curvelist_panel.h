@@ -46,8 +46,7 @@ public:
 
     bool is2ndColumnHidden() const;
 
-    void update2ndColumnValues(double time,
-                               std::unordered_map<std::string, PlotData>* numeric_data);
+    void update2ndColumnValues(double time, PlotDataMapRef* plot_data);
 
     virtual void keyPressEvent(QKeyEvent * event) override;
 
@@ -94,7 +93,7 @@ private:
     CurveTreeView* _tree_view;
 
     double _tracker_time = 0;
-    std::unordered_map<std::string, PlotData> *_numeric_data = nullptr;
+    PlotDataMapRef *_plot_data = nullptr;
 
     const CustomPlotMap& _custom_plots;
 
@@ -0,0 +1,123 @@
+#include "frame_pacer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const double AVERAGE_WEIGHT = 0.2;
+
+// longer pauses between frames are not caused by painting
+const double MAX_LATENESS = 1000.0;
+
+void updateAverage(double& average, double sample)
+{
+    average += AVERAGE_WEIGHT * (sample - average);
+}
+}
+
+FramePacer::FramePacer():
+    _period(40),
+    _max_cpu(1.0),
+    _has_previous_frame(false),
+    _delay(0),
+    _merge(0),
+    _transform(0),
+    _prev_plots_replotted(0),
+    _merge_avg(0),
+    _transform_avg(0),
+    _replot_avg(0),
+    _paint_avg(0)
+{
+}
+
+void FramePacer::setTarget(double target_fps, double max_cpu)
+{
+    _period  = 1000.0 / std::max( 1.0, target_fps );
+    _max_cpu = std::min( 1.0, std::max( 0.01, max_cpu ) );
+}
+
+int FramePacer::targetPeriod() const
+{
+    return static_cast<int>( std::lround(_period) );
+}
+
+void FramePacer::reset()
+{
+    _has_previous_frame = false;
+}
+
+double FramePacer::elapsed(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>( to - from ).count();
+}
+
+void FramePacer::beginFrame()
+{
+    const auto now = Clock::now();
+
+    // the canvas of the plots replotted in the previous frame was painted
+    // by the event loop, delaying this timer tick
+    if( _has_previous_frame && _prev_plots_replotted > 0 )
+    {
+        const double lateness = elapsed( _frame_end, now ) - _delay;
+        if( lateness < MAX_LATENESS )
+        {
+            updateAverage( _paint_avg, std::max(0.0, lateness) / _prev_plots_replotted );
+        }
+    }
+    _phase_start = now;
+}
+
+void FramePacer::endMerge()
+{
+    const auto now = Clock::now();
+    _merge = elapsed( _phase_start, now );
+    updateAverage( _merge_avg, _merge );
+    _phase_start = now;
+}
+
+void FramePacer::endTransform()
+{
+    const auto now = Clock::now();
+    _transform = elapsed( _phase_start, now );
+    updateAverage( _transform_avg, _transform );
+    _phase_start = now;
+}
+
+void FramePacer::endFrame(size_t plots_replotted)
+{
+    _frame_end = Clock::now();
+    if( plots_replotted > 0 )
+    {
+        updateAverage( _replot_avg, elapsed( _phase_start, _frame_end ) / plots_replotted );
+    }
+    _prev_plots_replotted = plots_replotted;
+    _has_previous_frame = true;
+}
+
+size_t FramePacer::replotBudget(size_t plots_to_replot) const
+{
+    const double per_plot = _replot_avg + _paint_avg;
+    if( _max_cpu >= 1.0 || per_plot <= 0.0 )
+    {
+        return plots_to_replot;
+    }
+    const double available = _period * _max_cpu - _merge - _transform;
+    const double count = std::floor( available / per_plot );
+
+    if( count < 1.0 ){
+        return std::min<size_t>( 1, plots_to_replot );
+    }
+    return std::min( plots_to_replot, static_cast<size_t>(count) );
+}
+
+int FramePacer::nextDelay()
+{
+    const double synchronous = _merge_avg + _transform_avg + _replot_avg * _prev_plots_replotted;
+    const double total = synchronous + _paint_avg * _prev_plots_replotted;
+
+    // slow down until frames use at most _max_cpu of the time
+    const double period = std::max( _period, total / _max_cpu );
+
+    _delay = std::max( 1, static_cast<int>( std::lround( period - synchronous ) ) );
+    return _delay;
+}
@@ -0,0 +1,76 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <cstddef>
+
+/**
+ * @brief Measures the cost of the frames drawn in streaming mode and decides
+ * when the next one should start and how many plots it may replot.
+ *
+ * A frame is made of three phases: merge of the new data, computation of the
+ * transforms/custom plots and replot of the widgets. Qwt paints the canvas
+ * later, in the event loop; that time is measured as the lateness of the
+ * following frame and attributed to the plots replotted.
+ *
+ * All the times are in milliseconds.
+ */
+class FramePacer
+{
+public:
+    FramePacer();
+
+    /// max_cpu is the fraction (0, 1] of the time that frames may take.
+    void setTarget(double target_fps, double max_cpu);
+
+    int targetPeriod() const;
+
+    /// Forget the previous frame; call it when the timer is (re)started.
+    void reset();
+
+    void beginFrame();
+
+    void endMerge();
+
+    void endTransform();
+
+    /// plots_replotted is the number of widgets that will be painted.
+    void endFrame(size_t plots_replotted);
+
+    /// How many of the plots_to_replot fit in the budget of this frame (at least one).
+    size_t replotBudget(size_t plots_to_replot) const;
+
+    /// Delay before the next frame. When frames are slower than the target,
+    /// it grows, so that timer ticks never pile up.
+    int nextDelay();
+
+    double mergeTime() const     { return _merge_avg; }
+    double transformTime() const { return _transform_avg; }
+    double paintTimePerPlot() const { return _replot_avg + _paint_avg; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static double elapsed(Clock::time_point from, Clock::time_point to);
+
+    double _period;
+    double _max_cpu;
+
+    Clock::time_point _phase_start;
+    Clock::time_point _frame_end;
+    bool _has_previous_frame;
+    int _delay;
+
+    double _merge;
+    double _transform;
+
+    size_t _prev_plots_replotted;
+
+    // exponential moving averages. replot and paint are per plot
+    double _merge_avg;
+    double _transform_avg;
+    double _replot_avg;
+    double _paint_avg;
+};
+
+#endif // FRAME_PACER_H
@@ -1,6 +1,8 @@
 #include <functional>
 #include <stdio.h>
 #include <numeric>
+#include <algorithm>
+#include <unordered_set>
 
 #include <QApplication>
 #include <QActionGroup>
@@ -37,6 +39,7 @@
 #include "PlotJuggler/plotdata.h"
 #include "qwt_plot_canvas.h"
 #include "transforms/function_editor.h"
+#include "transforms/custom_function_scheduler.h"
 #include "utils.h"
 
 #include "ui_aboutdialog.h"
@@ -53,6 +56,7 @@ MainWindow::MainWindow(const QCommandLineParser &commandline_parser, QWidget *pa
     _streaming_shortcut(QKeySequence(Qt::CTRL + Qt::Key_Space), this),
     _playback_shotcut(Qt::Key_Space, this),
     _minimized(false),
+    _updating_custom_plots(false),
     _current_streamer(nullptr),
     _disable_undo_logging(false),
     _tracker_time(0),
@@ -129,9 +133,18 @@ MainWindow::MainWindow(const QCommandLineParser &commandline_parser, QWidget *pa
     // save initial state
     onUndoableChange();
 
+    // single shot: each frame schedules the next one, according to its cost
     _replot_timer = new QTimer(this);
-    _replot_timer->setInterval(40);
-    connect(_replot_timer, &QTimer::timeout, this, [this](){ updateDataAndReplot(false); } );
+    _replot_timer->setSingleShot(true);
+    connect(_replot_timer, &QTimer::timeout, this, [this]()
+    {
+        updateDataAndReplot(false);
+        if( isStreamingActive() )
+        {
+            _replot_timer->start( _frame_pacer.nextDelay() );
+        }
+    } );
+    loadFramePacing();
 
     _publish_timer = new QTimer(this);
     _publish_timer->setInterval(20);
@@ -268,7 +281,7 @@ void MainWindow::onUndoInvoked( )
 
 void MainWindow::onUpdateLeftTableValues()
 {
-    _curvelist_widget->update2ndColumnValues( _tracker_time, &_mapped_plot_data.numeric );
+    _curvelist_widget->update2ndColumnValues( _tracker_time, &_mapped_plot_data );
 }
 
 
@@ -804,7 +817,7 @@ void MainWindow::onDeleteMultipleCurves(const std::vector<std::string> &curve_na
         }
 
         emit requestRemoveCurveByName( curve_name );
-        _mapped_plot_data.numeric.erase( plot_curve );
+        _mapped_plot_data.eraseNumeric( plot_curve );
 
         auto custom_it = _custom_plots.find( curve_name );
         if( custom_it != _custom_plots.end())
@@ -912,12 +925,14 @@ void MainWindow::deleteAllData()
         plot->detachAllCurves();
     } );
 
-    _mapped_plot_data.numeric.clear();
-    _mapped_plot_data.user_defined.clear();
+    _mapped_plot_data.clear();
     _custom_plots.clear();
     _curvelist_widget->clear();
     _loaded_datafiles.clear();
 
+    // the last snapshot shouldn't keep the old data alive
+    _data_publisher.publish( _mapped_plot_data );
+
     bool stopped = false;
     for (QAction* action: ui->menuPublishers->actions())
     {
@@ -940,7 +955,8 @@ void MainWindow::deleteAllData()
 template <typename T>
 void importPlotDataMapHelper(std::unordered_map<std::string,T>& source,
                              std::unordered_map<std::string,T>& destination,
-                             bool delete_older)
+                             bool delete_older,
+                             bool compact_storage)
 {
     for (auto& it: source)
     {
@@ -966,11 +982,9 @@ void importPlotDataMapHelper(std::unordered_map<std::string,T>& source,
         }
         else
         {
-            for (size_t i=0; i< source_plot.size(); i++)
-            {
-                destination_plot.pushBack( source_plot.at(i) );
-            }
+            destination_plot.spliceBack(source_plot);
         }
+        destination_plot.setCompactStorage(compact_storage);
         source_plot.clear();
     }
 }
@@ -1020,8 +1034,11 @@ void MainWindow::importPlotDataMap(PlotDataMapRef& new_data, bool remove_old)
         }
     }
 
-    importPlotDataMapHelper( new_data.numeric, _mapped_plot_data.numeric, remove_old );
-    importPlotDataMapHelper( new_data.user_defined, _mapped_plot_data.user_defined, remove_old );
+    QSettings settings;
+    const bool compact_storage = settings.value("Preferences::compact_storage", false).toBool();
+
+    importPlotDataMapHelper( new_data.numeric, _mapped_plot_data.numeric, remove_old, compact_storage );
+    importPlotDataMapHelper( new_data.user_defined, _mapped_plot_data.user_defined, remove_old, compact_storage );
 
     if( curvelist_modified )
     {
@@ -1613,9 +1630,19 @@ bool MainWindow::loadLayoutFromFile(QString filename)
                 CustomPlotPtr new_custom_plot = CustomFunction::createFromXML(custom_eq);
                 const auto& name = new_custom_plot->name();
                 _custom_plots[name] = new_custom_plot;
-                new_custom_plot->calculateAndAdd( _mapped_plot_data );
+
+                auto data_it = _mapped_plot_data.numeric.find( name );
+                if( data_it == _mapped_plot_data.numeric.end() )
+                {
+                    _mapped_plot_data.addNumeric( name );
+                }
+                else{
+                    data_it->second.clear();
+                }
                 _curvelist_widget->addCustom( QString::fromStdString( name ) );
             }
+            // computed all together, because they might depend on each other
+            updateCustomPlots();
             _curvelist_widget->refreshColumns();
         }
     }
@@ -1847,6 +1874,7 @@ void MainWindow::on_pushButtonStreaming_toggled(bool streaming)
 
     if( _current_streamer && streaming)
     {
+        _frame_pacer.reset();
         _replot_timer->start();
         updateTimeOffset();
     }
@@ -1856,6 +1884,27 @@ void MainWindow::on_pushButtonStreaming_toggled(bool streaming)
     }
 }
 
+void MainWindow::updateCustomPlots()
+{
+    if( _updating_custom_plots )
+    {
+        return;
+    }
+    _updating_custom_plots = true;
+
+    CustomFunctionScheduler scheduler( _custom_plots, _mapped_plot_data );
+    scheduler.run( this );
+
+    _updating_custom_plots = false;
+
+    if( !scheduler.errors().empty() )
+    {
+        QMessageBox::warning(this, tr("Custom plots"),
+                             tr("Failed to compute some custom plots:\n\n%1\n")
+                             .arg( scheduler.errors().join("\n") ) );
+    }
+}
+
 void MainWindow::on_streamingToggled()
 {
     if( ui->pushButtonStreaming->isEnabled() )
@@ -1874,11 +1923,40 @@ void MainWindow::on_streamingToggled()
 
 void MainWindow::updateDataAndReplot(bool replot_hidden_tabs)
 {
-    if( _current_streamer )
+    // called again by the event loop of updateCustomPlots()
+    if( _updating_custom_plots )
     {
-        std::lock_guard<std::mutex> lock( _current_streamer->mutex() );
+        return;
+    }
+
+    // only the periodic frames of the streaming mode are paced
+    const bool paced_frame = !replot_hidden_tabs;
+    if( paced_frame )
+    {
+        _frame_pacer.beginFrame();
+    }
 
-        auto curvelist_added = _current_streamer->appendData( _mapped_plot_data );
+    if( _current_streamer )
+    {
+        // lock-free: the batches published by the streaming thread
+        bool cleared = false;
+        auto curvelist_added = _current_streamer->appendBatches( _mapped_plot_data, &cleared );
+        if( cleared )
+        {
+            // the timeseries were cleared before appending the latest samples
+            for (auto& it: _custom_plots )
+            {
+                it.second->clear();
+            }
+            forEachWidget( [](PlotWidget* plot) {
+                plot->reloadPlotData();
+            });
+        }
+        {
+            std::lock_guard<std::mutex> lock( _current_streamer->mutex() );
+            auto added = _current_streamer->appendData( _mapped_plot_data );
+            curvelist_added.insert( curvelist_added.end(), added.begin(), added.end() );
+        }
 
         for(const auto& str: curvelist_added)
         {
@@ -1891,20 +1969,48 @@ void MainWindow::updateDataAndReplot(bool replot_hidden_tabs)
         }
     }
 
-    for( auto& custom_it: _custom_plots)
+    if( paced_frame )
+    {
+        _frame_pacer.endMerge();
+    }
+
+    if( paced_frame )
+    {
+        // the few samples added by a frame aren't worth the worker threads
+        for( auto& custom_it: _custom_plots)
+        {
+            auto* dst_plot = &_mapped_plot_data.numeric.at(custom_it.first);
+            custom_it.second->calculate(_mapped_plot_data, dst_plot);
+        }
+    }
+    else{
+        updateCustomPlots();
+    }
+
+    // readers in other threads get a consistent copy of the data
+    if( _data_publisher.wanted() )
     {
-        auto* dst_plot = &_mapped_plot_data.numeric.at(custom_it.first);
-        custom_it.second->calculate(_mapped_plot_data, dst_plot);
+        _data_publisher.publish( _mapped_plot_data );
     }
 
     const bool is_streaming_active = isStreamingActive();
 
-    forEachWidget( [is_streaming_active](PlotWidget* plot)
+    std::unordered_set<PlotWidget*> modified_plots;
+
+    forEachWidget( [is_streaming_active, &modified_plots](PlotWidget* plot)
     {
-        plot->updateCurves();
+        if( plot->updateCurves() )
+        {
+            modified_plots.insert( plot );
+        }
         plot->setZoomEnabled( !is_streaming_active );
     } );
 
+    if( paced_frame )
+    {
+        _frame_pacer.endTransform();
+    }
+
     //--------------------------------
     // trigger again the execution of this callback if steaming == true
     if( is_streaming_active )
@@ -1920,9 +2026,10 @@ void MainWindow::updateDataAndReplot(bool replot_hidden_tabs)
         updateTimeSlider();
     }
     //--------------------------------
-    for(const auto& it: TabbedPlotWidget::instances())
+    if( replot_hidden_tabs )
     {
-        if( replot_hidden_tabs )
+        _deferred_replots.clear();
+        for(const auto& it: TabbedPlotWidget::instances())
         {
             QTabWidget* tabs = it.second->tabWidget();
             for (int index=0; index < tabs->count(); index++)
@@ -1931,11 +2038,45 @@ void MainWindow::updateDataAndReplot(bool replot_hidden_tabs)
                 matrix->maximumZoomOut();
             }
         }
+        return;
+    }
+
+    // only the visible plots with new data are zoomed out and painted again.
+    // The ones deferred by the previous frames go first.
+    std::vector<PlotWidget*> to_replot;
+    for(const auto& it: TabbedPlotWidget::instances())
+    {
+        PlotMatrix* matrix =  it.second->currentTab() ;
+        for (unsigned i = 0; i < matrix->plotCount(); i++)
+        {
+            PlotWidget* plot = matrix->plotAt(i);
+            if( (modified_plots.count( plot ) || _deferred_replots.count( plot ))
+                && !plot->isEmpty() )
+            {
+                to_replot.push_back( plot );
+            }
+        }
+    }
+    std::stable_partition( to_replot.begin(), to_replot.end(), [this](PlotWidget* plot)
+    {
+        return _deferred_replots.count( plot ) > 0;
+    } );
+
+    const size_t budget = _frame_pacer.replotBudget( to_replot.size() );
+
+    _deferred_replots.clear();
+    for (size_t i = 0; i < to_replot.size(); i++)
+    {
+        if( i < budget )
+        {
+            to_replot[i]->zoomOut(false);
+            to_replot[i]->replot();
+        }
         else{
-            PlotMatrix* matrix =  it.second->currentTab() ;
-            matrix->maximumZoomOut(); // includes replot
+            _deferred_replots.insert( to_replot[i] );
         }
     }
+    _frame_pacer.endFrame( std::min( budget, to_replot.size() ) );
 }
 
 void MainWindow::on_streamingSpinBox_valueChanged(int value)
@@ -1947,19 +2088,25 @@ void MainWindow::on_streamingSpinBox_valueChanged(int value)
         return;
     }
 
+    QSettings settings;
+    const size_t memory_budget = size_t(settings.value("Preferences::streaming_memory_MB", 64).toInt()) * 1024 * 1024;
+
     for (auto& it : _mapped_plot_data.numeric )
     {
         it.second.setMaximumRangeX( real_value );
+        it.second.setMemoryBudget( memory_budget );
     }
 
     for (auto& it: _mapped_plot_data.user_defined)
     {
         it.second.setMaximumRangeX( real_value );
+        it.second.setMemoryBudget( memory_budget );
     }
 
     if( _current_streamer )
     {
         _current_streamer->setMaximumRange( real_value );
+        _current_streamer->setMemoryBudget( memory_budget );
     }
 }
 
@@ -2767,5 +2914,16 @@ void MainWindow::on_actionPreferences_triggered()
         _style_directory = theme;
         emit stylesheetChanged(_style_directory);
     }
+    loadFramePacing();
+}
+
+void MainWindow::loadFramePacing()
+{
+    QSettings settings;
+    const int target_fps = settings.value("Preferences::streaming_target_fps", 25).toInt();
+    const int max_cpu = settings.value("Preferences::streaming_max_cpu", 100).toInt();
+
+    _frame_pacer.setTarget( target_fps, max_cpu / 100.0 );
+    _replot_timer->setInterval( _frame_pacer.targetPeriod() );
 }
 
@@ -3,6 +3,7 @@
 
 #include <set>
 #include <deque>
+#include <unordered_set>
 #include <functional>
 
 #include <QCommandLineParser>
@@ -18,6 +19,7 @@
 #include "subwindow.h"
 #include "realslider.h"
 #include "utils.h"
+#include "frame_pacer.h"
 #include "PlotJuggler/dataloader_base.h"
 #include "PlotJuggler/statepublisher_base.h"
 #include "PlotJuggler/datastreamer_base.h"
@@ -103,7 +105,10 @@ private:
     CurveListPanel* _curvelist_widget;
 
     PlotDataMapRef  _mapped_plot_data;
+    PlotDataMapPublisher _data_publisher;
     CustomPlotMap _custom_plots;
+    // the worker threads of updateCustomPlots() are using _mapped_plot_data
+    bool _updating_custom_plots;
 
     std::map<QString,DataLoader*>      _data_loader;
     std::map<QString,StatePublisher*>  _state_publisher;
@@ -132,6 +137,9 @@ private:
     QString _style_directory;
 
     QTimer *_replot_timer;
+    FramePacer _frame_pacer;
+    // modified plots that didn't fit in the budget of the previous frames
+    std::unordered_set<PlotWidget*> _deferred_replots;
     QTimer *_publish_timer;
 
     QDateTime _prev_publish_time;
@@ -174,6 +182,10 @@ private:
     void updateTimeSlider();
     void updateTimeOffset();
 
+    void loadFramePacing();
+
+    void updateCustomPlots();
+
     void buildDummyData();
 
 signals:
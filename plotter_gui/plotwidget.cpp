@@ -7,6 +7,7 @@
 #include <QDragMoveEvent>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QMenu>
 #include <QMimeData>
@@ -37,6 +38,7 @@
 #include "suggest_dialog.h"
 #include "transforms/custom_function.h"
 #include "transforms/custom_timeseries.h"
+#include "transforms/filter_transform.h"
 
 int PlotWidget::global_color_index = 0;
 
@@ -91,6 +93,22 @@ class TimeScaleDraw: public QwtScaleDraw
     }
 };
 
+// The samples of the series are decimated only while the curve is painted
+class TimeseriesCurve: public QwtPlotCurve
+{
+public:
+    explicit TimeseriesCurve(const QString& title): QwtPlotCurve(title) {}
+
+    void drawSeries(QPainter *painter, const QwtScaleMap &xMap, const QwtScaleMap &yMap,
+                    const QRectF &canvasRect, int from, int to) const override
+    {
+        auto series = const_cast<DataSeriesBase*>( static_cast<const DataSeriesBase*>( data() ) );
+        series->setPainting( true );
+        QwtPlotCurve::drawSeries( painter, xMap, yMap, canvasRect, from, to );
+        series->setPainting( false );
+    }
+};
+
 const double MAX_DOUBLE = std::numeric_limits<double>::max() / 2 ;
 
 static const char* noTransform = "noTransform";
@@ -98,11 +116,19 @@ static const char* Derivative1st = "1st Derivative";
 static const char* Derivative2nd = "2nd Derivative";
 static bool if_xy_plot_failed_show_dialog = true;
 
-static QStringList builtin_trans = {
-    noTransform,
-    Derivative1st,
-    Derivative2nd
-};
+static QStringList BuiltinTransforms()
+{
+    QStringList builtin_trans = {
+        noTransform,
+        Derivative1st,
+        Derivative2nd
+    };
+    for (const auto& filter: BuiltinFilters())
+    {
+        builtin_trans.push_back( filter.name );
+    }
+    return builtin_trans;
+}
 
 PlotWidget::PlotWidget(PlotDataMapRef &datamap, QWidget *parent):
     QwtPlot(parent),
@@ -290,6 +316,36 @@ void PlotWidget::buildActions()
         this->on_changeToBuiltinTransforms(Derivative2nd);
     } );
 
+    _filters_menu = new QMenu(tr("&Filters"), this);
+    for (const auto& filter: BuiltinFilters())
+    {
+        const FilterInfo* info = &filter;
+        QAction* action = _filters_menu->addAction( info->name );
+        action->setCheckable( true );
+        // triggered also when it is checked already, to change the parameter
+        connect(action, &QAction::triggered, this, [this, info]()
+        {
+            if( info->parameter )
+            {
+                bool ok = false;
+                const double value = QInputDialog::getDouble(this, info->name, info->parameter,
+                                                             filterParameter(*info),
+                                                             info->min_parameter, info->max_parameter,
+                                                             info->decimals, &ok);
+                if( !ok )
+                {
+                    if( _previous_transform_action ){
+                        _previous_transform_action->setChecked( true );
+                    }
+                    return;
+                }
+                _filter_parameters[ info->name ] = value;
+            }
+            this->changeToFilter( *info );
+        } );
+        _action_filters.push_back( action );
+    }
+
     _action_custom_transform = new QAction(tr("&Custom..."), this);
     _action_custom_transform->setCheckable( true );
     connect(_action_custom_transform, &QAction::triggered,
@@ -302,13 +358,18 @@ void PlotWidget::buildActions()
     _action_XY_transform->setCheckable( true );
     _action_XY_transform->setEnabled(false);
 
-    auto transform_group = new QActionGroup(this);
+    _transform_group = new QActionGroup(this);
+    _previous_transform_action = nullptr;
 
-    transform_group->addAction(_action_noTransform);
-    transform_group->addAction(_action_1stDerivativeTransform);
-    transform_group->addAction(_action_2ndDerivativeTransform);
-    transform_group->addAction(_action_custom_transform);
-    transform_group->addAction(_action_XY_transform);
+    _transform_group->addAction(_action_noTransform);
+    _transform_group->addAction(_action_1stDerivativeTransform);
+    _transform_group->addAction(_action_2ndDerivativeTransform);
+    for (QAction* action: _action_filters)
+    {
+        _transform_group->addAction(action);
+    }
+    _transform_group->addAction(_action_custom_transform);
+    _transform_group->addAction(_action_XY_transform);
 }
 
 
@@ -353,10 +414,14 @@ void PlotWidget::canvasContextMenuTriggered(const QPoint &pos)
     menu.addAction( _action_XY_transform );
     menu.addAction( _action_1stDerivativeTransform );
     menu.addAction( _action_2ndDerivativeTransform );
+    menu.addMenu( _filters_menu );
     menu.addAction( _action_custom_transform );
     menu.addSeparator();
     menu.addAction( _action_saveToFile );
 
+    // restored if the user doesn't confirm the parameter of a filter
+    _previous_transform_action = _transform_group->checkedAction();
+
     _action_removeCurve->setEnabled( ! _curve_list.empty() );
     _action_removeAllCurves->setEnabled( ! _curve_list.empty() );
     _action_changeColorsDialog->setEnabled(  ! _curve_list.empty() );
@@ -364,6 +429,7 @@ void PlotWidget::canvasContextMenuTriggered(const QPoint &pos)
     _action_noTransform->setEnabled( !_xy_mode );
     _action_1stDerivativeTransform->setEnabled( !_xy_mode );
     _action_2ndDerivativeTransform->setEnabled( !_xy_mode );
+    _filters_menu->setEnabled( !_xy_mode );
     _action_custom_transform->setEnabled( !_xy_mode );
 
      menu.exec(canvas()->mapToGlobal(pos));
@@ -391,7 +457,7 @@ bool PlotWidget::addCurve(const std::string &name)
     PlotData& data = it->second;
     const auto qname = QString::fromStdString( name );
 
-    auto curve = new QwtPlotCurve( qname );
+    auto curve = new TimeseriesCurve( qname );
     try {
         auto plot_qwt = createTimeSeries( _default_transform, &data );
         _curves_transform.insert( {name, _default_transform} );
@@ -415,6 +481,7 @@ bool PlotWidget::addCurve(const std::string &name)
 
     curve->attach( this );
     _curve_list.insert( std::make_pair(name, curve));
+    _curve_ids.insert( std::make_pair(name, _mapped_data.getID(name)) );
 
     auto marker = new QwtPlotMarker;
     _point_marker.insert( std::make_pair(name, marker) );
@@ -504,6 +571,7 @@ bool PlotWidget::addCurveXY(std::string name_x, std::string name_y,
 
     curve->attach( this );
     _curve_list.insert( std::make_pair(name, curve));
+    _curve_ids.insert( std::make_pair(name, _mapped_data.getID(name)) );
 
     auto marker = new QwtPlotMarker;
     _point_marker.insert( std::make_pair(name, marker) );
@@ -547,6 +615,7 @@ void PlotWidget::removeCurve(const std::string &curve_name)
             }
 
             _curves_transform.erase( it->first );
+            _curve_ids.erase( it->first );
             it = _curve_list.erase( it );
         }
         else{
@@ -726,6 +795,7 @@ void PlotWidget::detachAllCurves()
         _action_noTransform->trigger();
     }
     _curve_list.clear();
+    _curve_ids.clear();
     _curves_transform.clear();
     _point_marker.clear();
 
@@ -795,6 +865,14 @@ QDomElement PlotWidget::xmlSaveState( QDomDocument &doc) const
 
     plot_el.appendChild(transform);
 
+    for (const auto& it: _filter_parameters)
+    {
+        QDomElement filter = doc.createElement("filter");
+        filter.setAttribute("name", it.first);
+        filter.setAttribute("parameter", it.second);
+        plot_el.appendChild(filter);
+    }
+
     return plot_el;
 }
 
@@ -805,6 +883,15 @@ bool PlotWidget::xmlLoadState(QDomElement &plot_widget)
     QDomElement transform = plot_widget.firstChildElement( "transform" );
     QString trans_value = transform.attribute("value");
 
+    // before any curve is added with a filter
+    _filter_parameters.clear();
+    for (QDomElement filter = plot_widget.firstChildElement( "filter" );
+         !filter.isNull();
+         filter = filter.nextSiblingElement( "filter" ) )
+    {
+        _filter_parameters[ filter.attribute("name") ] = filter.attribute("parameter").toDouble();
+    }
+
     if( trans_value == "XYPlot" )
     {
         convertToXY();
@@ -916,6 +1003,10 @@ bool PlotWidget::xmlLoadState(QDomElement &plot_widget)
     {
         _action_2ndDerivativeTransform->trigger();
     }
+    else if( const FilterInfo* filter = FindBuiltinFilter( trans_value ) )
+    {
+        changeToFilter( *filter );
+    }
     else if( trans_value.startsWith("Custom::" ) )
     {
         _default_transform = trans_value.remove(0, 8);
@@ -1137,12 +1228,11 @@ void PlotWidget::reloadPlotData()
         auto& curve = curve_it.second;
         const auto& curve_name = curve_it.first;
 
-        auto data_it = _mapped_data.numeric.find( curve_name );
-        if( data_it != _mapped_data.numeric.end())
+        const PlotData* data = _mapped_data.numericByID( _curve_ids.at(curve_name) );
+        if( data )
         {
-            const auto& data = data_it->second;
             const auto& transform = _curves_transform.at(curve_name);
-            auto data_series = createTimeSeries( transform, &data);
+            auto data_series = createTimeSeries( transform, data);
             curve->setData( data_series );
         }
     }
@@ -1344,16 +1434,26 @@ PlotData::RangeValue  PlotWidget::getMaximumRangeY( PlotData::RangeTime range_X)
 }
 
 
-void PlotWidget::updateCurves()
+void PlotWidget::setCurvesCanvasWidth(int width)
 {
     for(auto& it: _curve_list)
     {
         auto series = static_cast<DataSeriesBase*>( it.second->data() );
-        bool res = series->updateCache();
-        //TODO check res and do something if false.
+        series->setCanvasWidth( width );
     }
 }
 
+bool PlotWidget::updateCurves()
+{
+    bool modified = false;
+    for(auto& it: _curve_list)
+    {
+        auto series = static_cast<DataSeriesBase*>( it.second->data() );
+        modified |= series->updateCacheIfModified();
+    }
+    return modified;
+}
+
 void PlotWidget::launchRemoveCurveDialog()
 {
     RemoveCurveDialog* dialog = new RemoveCurveDialog(this);
@@ -1630,7 +1730,7 @@ void PlotWidget::on_customTransformsDialog()
         }
     }
 
-    TransformSelector dialog( builtin_trans, available_trans,
+    TransformSelector dialog( BuiltinTransforms(), available_trans,
                               &_default_transform, &_curves_transform,
                               this);
 
@@ -1680,6 +1780,9 @@ void PlotWidget::on_savePlotToFile()
         QRect documentRect(0,0,1200, 900);
         QwtPlotRenderer rend;
 
+        // the resolution of the document differs from the one of the canvas
+        setCurvesCanvasWidth( 0 );
+
         if( QFileInfo(fileName).suffix().toLower() == "svg")
         {
           QSvgGenerator generator;
@@ -1698,8 +1801,8 @@ void PlotWidget::on_savePlotToFile()
 
         if( tracker_enabled ){
           this->enableTracker(true);
-          replot();
         }
+        replot();
     }
 }
 
@@ -1991,6 +2094,10 @@ DataSeriesBase *PlotWidget::createTimeSeries(const QString &ID, const PlotData *
     {
         output = new Timeseries_2ndDerivative( data );
     }
+    else if( const FilterInfo* filter = FindBuiltinFilter(ID) )
+    {
+        output = new Timeseries_Filter( data, *filter, filterParameter(*filter) );
+    }
 
     auto custom_it = _snippets.find(ID);
     if( custom_it != _snippets.end())
@@ -2006,6 +2113,31 @@ DataSeriesBase *PlotWidget::createTimeSeries(const QString &ID, const PlotData *
     return output;
 }
 
+double PlotWidget::filterParameter(const FilterInfo &filter) const
+{
+    auto it = _filter_parameters.find( filter.name );
+    return (it == _filter_parameters.end()) ? filter.default_parameter : it->second;
+}
+
+void PlotWidget::changeToFilter(const FilterInfo &filter)
+{
+    const size_t index = size_t( &filter - BuiltinFilters().data() );
+    _action_filters[index]->setChecked( true );
+
+    QString footer = filter.name;
+    if( filter.parameter )
+    {
+        footer += QString(" (%1)").arg( filterParameter(filter) );
+    }
+    QFont font;
+    font.setPointSize(10);
+    QwtText text( footer );
+    text.setFont(font);
+    this->setFooter(text);
+
+    on_changeToBuiltinTransforms( filter.name );
+}
+
 void PlotWidget::changeBackgroundColor(QColor color)
 {
     if( canvasBackground().color() != color)
@@ -2053,6 +2185,11 @@ void PlotWidget::replot()
         _zoomer->setZoomBase( false );
     }
 
+    // decimation is pixel-exact only when the samples are connected by lines
+    const int canvas_width = (_curve_style == QwtPlotCurve::Lines) ?
+                canvas()->width() * canvas()->devicePixelRatio() : 0;
+    setCurvesCanvasWidth( canvas_width );
+
     QwtPlot::replot();
     //  qDebug() << replot_count++;
 }
@@ -23,8 +23,12 @@
 #include "axis_limits_dialog.h"
 #include "transforms/transform_selector.h"
 #include "transforms/custom_function.h"
+#include "transforms/filter_transform.h"
 #include "plotlegend.h"
 
+class QActionGroup;
+class QMenu;
+
 class PlotWidget : public QwtPlot
 {
     Q_OBJECT
@@ -98,7 +102,8 @@ public slots:
 
     void replot() override;
 
-    void updateCurves();
+    /// Returns true if the data of any curve was modified since the last call.
+    bool updateCurves();
 
     void detachAllCurves();
 
@@ -157,6 +162,7 @@ private:
 
     std::map<std::string, QwtPlotCurve* > _curve_list;
     std::map<std::string, QwtPlotMarker*> _point_marker;
+    std::map<std::string, PlotDataMapRef::SeriesID> _curve_ids;
 
     QAction *_action_removeCurve;
     QAction *_action_removeAllCurves;
@@ -170,6 +176,10 @@ private:
     QAction *_action_2ndDerivativeTransform;
     QAction *_action_custom_transform;
     QAction *_action_XY_transform;
+    QMenu *_filters_menu;
+    std::vector<QAction*> _action_filters; // same order of BuiltinFilters()
+    QActionGroup *_transform_group;
+    QAction *_previous_transform_action;
     QAction *_action_saveToFile;
     QAction *_action_editLimits;
 
@@ -190,6 +200,8 @@ private:
     PlotDataMapRef& _mapped_data;
     QString _default_transform;
     std::map<std::string, QString> _curves_transform;
+    // parameter of the builtin filters, by name; the default one if missing
+    std::map<QString, double> _filter_parameters;
 
     struct DragInfo{
         enum{ NONE, CURVES, NEW_XY, SWAP_PLOTS} mode;
@@ -212,10 +224,16 @@ private:
 
     void setDefaultRangeX();
 
+    void setCurvesCanvasWidth(int width);
+
     DataSeriesBase* createCurveXY(const PlotData *data_x, const PlotData *data_y);
     
     DataSeriesBase* createTimeSeries(const QString& ID, const PlotData *data);
 
+    double filterParameter(const FilterInfo& filter) const;
+
+    void changeToFilter(const FilterInfo& filter);
+
     double _time_offset;
 
     bool _xy_mode;
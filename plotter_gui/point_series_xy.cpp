@@ -6,9 +6,10 @@ PointSeriesXY::PointSeriesXY(const PlotData *x_axis, const PlotData *y_axis):
     DataSeriesBase( &_cached_curve ),
     _x_axis(x_axis),
     _y_axis(y_axis),
-    _cached_curve("")
+    _cached_curve(""),
+    _time_cursor(y_axis)
 {
-    updateCache();
+    updateCacheIfModified();
 }
 
 PlotData::RangeTimeOpt PointSeriesXY::getVisualizationRangeX()
@@ -28,7 +29,7 @@ nonstd::optional<QPointF> PointSeriesXY::sampleFromTime(double t)
         return {};
     }
 
-    int index = _y_axis->getIndexFromX(t);
+    int index = _time_cursor.getIndexFromX(t);
     if(index <0)
     {
         return {};
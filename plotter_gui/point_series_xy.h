@@ -27,6 +27,11 @@ public:
 
     bool updateCache() override;
 
+    uint64_t sourceGeneration() override
+    {
+        return _x_axis->generation() + _y_axis->generation();
+    }
+
     const PlotData* dataX() const { return _x_axis; }
     const PlotData* dataY() const { return _y_axis; }
 
@@ -35,6 +40,7 @@ protected:
     const PlotData *_x_axis;
     const PlotData *_y_axis;
     PlotData _cached_curve;
+    PlotData::IndexCursor _time_cursor;
 };
 
 #endif // POINT_SERIES_H
@@ -31,6 +31,18 @@ PreferencesDialog::PreferencesDialog(QWidget *parent) :
     else{
       ui->radioButtonLua->setChecked(true);
     }
+
+    int streaming_memory = settings.value("Preferences::streaming_memory_MB", 64).toInt();
+    ui->spinBoxStreamingMemory->setValue(streaming_memory);
+
+    bool compact_storage = settings.value("Preferences::compact_storage", false).toBool();
+    ui->checkBoxCompactStorage->setChecked(compact_storage);
+
+    int target_fps = settings.value("Preferences::streaming_target_fps", 25).toInt();
+    ui->spinBoxTargetFPS->setValue(target_fps);
+
+    int max_cpu = settings.value("Preferences::streaming_max_cpu", 100).toInt();
+    ui->spinBoxMaxCPU->setValue(max_cpu);
 }
 
 PreferencesDialog::~PreferencesDialog()
@@ -58,4 +70,16 @@ void PreferencesDialog::on_buttonBox_accepted()
     {
       settings.setValue("CustomFunction/next_language", "lua");
     }
+
+    settings.setValue("Preferences::streaming_memory_MB",
+                      ui->spinBoxStreamingMemory->value());
+
+    settings.setValue("Preferences::compact_storage",
+                      ui->checkBoxCompactStorage->isChecked());
+
+    settings.setValue("Preferences::streaming_target_fps",
+                      ui->spinBoxTargetFPS->value());
+
+    settings.setValue("Preferences::streaming_max_cpu",
+                      ui->spinBoxMaxCPU->value());
 }
@@ -10,7 +10,9 @@ class DataSeriesBase: public QwtSeriesData<QPointF>
 public:
     DataSeriesBase(const PlotData* transformed):
         _transformed_data(transformed),
-        _time_offset(0)
+        _time_offset(0),
+        _canvas_width(0),
+        _painting(false)
     {}
 
     virtual QPointF sample( size_t i ) const override
@@ -37,6 +39,25 @@ public:
         _time_offset = offset;
     }
 
+    double timeOffset() const { return _time_offset; }
+
+    /// Width of the canvas in pixels. Zero means that the samples must not be decimated.
+    void setCanvasWidth(int pixels)
+    {
+        _canvas_width = pixels;
+    }
+
+    int canvasWidth() const { return _canvas_width; }
+
+    /// Set while the curve is painted. Only the painter gets the decimated samples,
+    /// the other users of sample() (the tracker, for instance) get the real ones.
+    void setPainting(bool painting)
+    {
+        _painting = painting;
+    }
+
+    bool painting() const { return _painting; }
+
 
     void calculateBoundingBox();
 
@@ -46,9 +67,27 @@ public:
 
     virtual bool updateCache() = 0;
 
+    /// Changes every time the data used to compute this series is modified,
+    /// see PlotDataGeneric::generation().
+    virtual uint64_t sourceGeneration() = 0;
+
+    /// Call updateCache() only if the source data was modified since the last time.
+    /// Returns true if the cache was updated.
+    bool updateCacheIfModified()
+    {
+        const uint64_t generation = sourceGeneration();
+        if( _cache_generation && *_cache_generation == generation )
+        {
+            return false;
+        }
+        _cache_generation = generation;
+        updateCache();
+        return true;
+    }
+
     virtual PlotData::RangeTimeOpt getVisualizationRangeX()
     {
-        if( this->size() < 2 )
+        if( _transformed_data->size() < 2 )
             return  PlotData::RangeTimeOpt();
         else{
             return PlotData::RangeTimeOpt( { _bounding_box.left()  - _time_offset,
@@ -64,6 +103,9 @@ protected:
 private:
     const PlotData* _transformed_data;
     double _time_offset;
+    int _canvas_width;
+    bool _painting;
+    nonstd::optional<uint64_t> _cache_generation;
 };
 
 //--------------------------------------------
@@ -75,25 +117,14 @@ inline void DataSeriesBase::calculateBoundingBox()
         return;
     }
 
-    double min_y = _transformed_data->front().y;
-    double max_y = _transformed_data->front().y;
-
-    for (const auto& p: *_transformed_data )
-    {
-        if( p.y < min_y )
-        {
-            min_y = p.y;
-        }
-        else if( p.y > max_y )
-        {
-           max_y = p.y;
-        }
-    }
+    // The per-chunk min/max summary is updated when points are appended or
+    // removed from the front: no need to scan the whole series at every frame.
+    const auto range_y = _transformed_data->getRangeY( 0, _transformed_data->size() );
 
     _bounding_box.setLeft(  _transformed_data->front().x );
     _bounding_box.setRight( _transformed_data->back().x );
-    _bounding_box.setBottom( min_y );
-    _bounding_box.setTop( max_y );
+    _bounding_box.setBottom( range_y->min );
+    _bounding_box.setTop( range_y->max );
 }
 
 #endif // SERIES_DATA_H
@@ -0,0 +1,53 @@
+#include "shared_transform.h"
+#include <tuple>
+
+bool SharedTransform::Key::operator <(const Key& other) const
+{
+    return std::tie( source, transform_id, parameters ) <
+           std::tie( other.source, other.transform_id, other.parameters );
+}
+
+std::map<SharedTransform::Key, std::weak_ptr<SharedTransform>>& SharedTransform::registry()
+{
+    static std::map<Key, std::weak_ptr<SharedTransform>> instances;
+    return instances;
+}
+
+std::shared_ptr<SharedTransform> SharedTransform::find(const Key& key)
+{
+    auto& instances = registry();
+
+    // remove the transforms that aren't displayed anymore
+    for (auto it = instances.begin(); it != instances.end(); )
+    {
+        if( it->second.expired() ){
+            it = instances.erase(it);
+        }
+        else{
+            it++;
+        }
+    }
+
+    auto it = instances.find( key );
+    if( it == instances.end() )
+    {
+        return nullptr;
+    }
+    return it->second.lock();
+}
+
+void SharedTransform::insert(const Key& key, std::shared_ptr<SharedTransform> instance)
+{
+    registry()[key] = instance;
+}
+
+void SharedTransform::update()
+{
+    const uint64_t generation = inputGeneration();
+    if( _generation && *_generation == generation )
+    {
+        return;
+    }
+    _generation = generation;
+    compute();
+}
@@ -0,0 +1,83 @@
+#ifndef SHARED_TRANSFORM_H
+#define SHARED_TRANSFORM_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include "PlotJuggler/plotdata.h"
+
+/**
+ * Result of a transform applied to a series. There is a single instance
+ * for each combination of source, transform and parameters: all the curves
+ * that display it, in any PlotWidget, share it through get().
+ *
+ * The result is computed again only when the input data was modified,
+ * see inputGeneration().
+ */
+class SharedTransform
+{
+public:
+    virtual ~SharedTransform() = default;
+
+    /**
+     * The instance of T registered with this key; if there is none, it is
+     * created with T(args...). The instance lives as long as someone holds
+     * the returned pointer.
+     */
+    template <typename T, typename... Args>
+    static std::shared_ptr<T> get(const PlotData* source,
+                                  const std::string& transform_id,
+                                  const std::string& parameters,
+                                  Args&&... args);
+
+    /// Changes every time the data used by compute() is modified.
+    virtual uint64_t inputGeneration() = 0;
+
+    /// Does nothing if the input wasn't modified since the last call.
+    void update();
+
+    const PlotData* data() const { return &_data; }
+
+protected:
+    SharedTransform(): _data("") {}
+
+    virtual void compute() = 0;
+
+    PlotData _data;
+
+private:
+    struct Key{
+        const PlotData* source;
+        std::string transform_id;
+        std::string parameters;
+        bool operator <(const Key& other) const;
+    };
+
+    static std::map<Key, std::weak_ptr<SharedTransform>>& registry();
+
+    static std::shared_ptr<SharedTransform> find(const Key& key);
+
+    static void insert(const Key& key, std::shared_ptr<SharedTransform> instance);
+
+    nonstd::optional<uint64_t> _generation;
+};
+
+//--------------------------------------------
+template <typename T, typename... Args> inline
+std::shared_ptr<T> SharedTransform::get(const PlotData* source,
+                                        const std::string& transform_id,
+                                        const std::string& parameters,
+                                        Args&&... args)
+{
+    const Key key = { source, transform_id, parameters };
+    // the same transform_id is always used with the same type
+    auto instance = std::static_pointer_cast<T>( find(key) );
+    if( !instance )
+    {
+        instance = std::make_shared<T>( std::forward<Args>(args)... );
+        insert( key, instance );
+    }
+    return instance;
+}
+
+#endif // SHARED_TRANSFORM_H
@@ -8,10 +8,121 @@
 TimeseriesQwt::TimeseriesQwt(const PlotData *source_data, const PlotData *transformed_data):
     DataSeriesBase( transformed_data ),
     _source_data(source_data),
-    _cached_data("")
+    _downsample_key( {0, 0, 0, 0, QRectF(), 0, 0} ),
+    _use_downsampled(false),
+    _time_cursor(transformed_data)
 {
 }
 
+QPointF TimeseriesQwt::sample(size_t i) const
+{
+    if( painting() && _use_downsampled )
+    {
+        return _downsampled[i];
+    }
+    return DataSeriesBase::sample(i);
+}
+
+size_t TimeseriesQwt::size() const
+{
+    if( painting() )
+    {
+        updateDownsampled();
+        if( _use_downsampled )
+        {
+            return _downsampled.size();
+        }
+    }
+    return DataSeriesBase::size();
+}
+
+void TimeseriesQwt::setRectOfInterest(const QRectF &rect)
+{
+    _rect_of_interest = rect;
+}
+
+bool TimeseriesQwt::DownsampleKey::operator ==(const DownsampleKey& other) const
+{
+    return generation == other.generation && size == other.size && front_x == other.front_x && back_x == other.back_x &&
+           rect == other.rect && width == other.width && offset == other.offset;
+}
+
+void TimeseriesQwt::updateDownsampled() const
+{
+    const PlotData* data = transformedData();
+    const size_t data_size = data->size();
+    const int width = canvasWidth();
+
+    DownsampleKey key = { data->generation(),
+                          data_size,
+                          data_size > 0 ? data->front().x : 0.0,
+                          data_size > 0 ? data->back().x : 0.0,
+                          _rect_of_interest, width, timeOffset() };
+    if( key == _downsample_key )
+    {
+        return;
+    }
+    _downsample_key = key;
+    _downsampled.clear();
+    _use_downsampled = false;
+
+    if( width <= 0 || _rect_of_interest.width() <= 0 || data_size <= size_t(4*width) )
+    {
+        return;
+    }
+
+    const double offset = timeOffset();
+    const double x_min = _rect_of_interest.left()  + offset;
+    const double x_max = _rect_of_interest.right() + offset;
+    const double dx = (x_max - x_min) / width;
+
+    auto addPoint = [this, offset](double x, double y)
+    {
+        _downsampled.push_back( QPointF(x - offset, y) );
+    };
+
+    const size_t first = data->lowerBound( x_min );
+    const size_t last  = data->lowerBound( x_max );
+
+    _downsampled.reserve( 4*width + 2 );
+
+    // the samples just outside the visible area are needed to draw the lines at the borders
+    if( first > 0 )
+    {
+        addPoint( data->at(first-1).x, data->at(first-1).y );
+    }
+
+    size_t index = first;
+    for (int col = 1; col <= width && index < last; col++)
+    {
+        const size_t col_end = (col == width) ? last :
+                                                std::min( last, data->lowerBound( x_min + col*dx ) );
+        if( col_end - index <= 4 )
+        {
+            for (size_t i = index; i < col_end; i++)
+            {
+                addPoint( data->at(i).x, data->at(i).y );
+            }
+        }
+        else{
+            const auto range = data->getRangeY( index, col_end );
+            const auto& p_first = data->at( index );
+            const auto& p_last  = data->at( col_end-1 );
+            addPoint( p_first.x, p_first.y );
+            addPoint( p_first.x, range->min );
+            addPoint( p_last.x,  range->max );
+            addPoint( p_last.x,  p_last.y );
+        }
+        index = col_end;
+    }
+
+    if( last < data_size )
+    {
+        addPoint( data->at(last).x, data->at(last).y );
+    }
+    _use_downsampled = true;
+}
+
 PlotData::RangeValueOpt TimeseriesQwt::getVisualizationRangeY(PlotData::RangeTime range_X)
 {
     int first_index = transformedData()->getIndexFromX( range_X.min );
@@ -29,22 +140,13 @@ PlotData::RangeValueOpt TimeseriesQwt::getVisualizationRangeY(PlotData::RangeTim
                                           _bounding_box.top() } );
     }
 
-    double min_y =( std::numeric_limits<double>::max() );
-    double max_y =(-std::numeric_limits<double>::max() );
-
-    for (size_t i = first_index; i < last_index; i++)
-    {
-        const double Y = sample(i).y();
-        min_y = std::min( min_y, Y );
-        max_y = std::max( max_y, Y );
-    }
-    return PlotData::RangeValueOpt( { min_y, max_y } );
+    return transformedData()->getRangeY( first_index, last_index+1 );
 }
 
 
 nonstd::optional<QPointF> TimeseriesQwt::sampleFromTime(double t)
 {
-    int index = transformedData()->getIndexFromX(t);
+    int index = _time_cursor.getIndexFromX(t);
     if( index < 0 )
     {
         return nonstd::optional<QPointF>();
@@ -60,59 +162,106 @@ bool Timeseries_NoTransform::updateCache()
     return true;
 }
 
-bool Timeseries_1stDerivative::updateCache()
+Timeseries_Shared::Timeseries_Shared(const PlotData *source_data,
+                                     std::shared_ptr<SharedTransform> transform):
+    TimeseriesQwt( source_data, transform->data() ),
+    _shared_transform( std::move(transform) )
 {
-    size_t data_size = _source_data->size();
+    updateCacheIfModified();
+}
 
-    if( data_size <= 1)
-    {
-        _cached_data.clear();
-        _bounding_box = QRectF();
-        return true;
-    }
+bool Timeseries_Shared::updateCache()
+{
+    // no-op if another curve already updated the shared transform
+    _shared_transform->update();
+    calculateBoundingBox();
+    return true;
+}
 
-    data_size = data_size - 1;
-    _cached_data.resize( data_size );
+DerivativeTransform::DerivativeTransform(const PlotData *source, int order):
+    _source(source),
+    _order(order),
+    _last_point(0, 0),
+    _last_repeats(0)
+{
+}
 
-    for (size_t i=0; i < data_size; i++ )
+PlotData::Point DerivativeTransform::derivativeAt(size_t last) const
+{
+    if( _order == 1 )
     {
-        const auto& p0 = _source_data->at( i );
-        const auto& p1 = _source_data->at( i+1 );
+        const auto& p0 = _source->at( last-1 );
+        const auto& p1 = _source->at( last );
         const auto delta = p1.x - p0.x;
         const auto vel = (p1.y - p0.y) /delta;
-        QPointF p( (p1.x + p0.x)*0.5, vel);
-        _cached_data[i] = { p.x(), p.y() };
+        return PlotData::Point( (p1.x + p0.x)*0.5, vel );
     }
-
-    calculateBoundingBox();
-    return true;
+    const auto& p0 = _source->at( last-2 );
+    const auto& p1 = _source->at( last-1 );
+    const auto& p2 = _source->at( last );
+    const auto delta = (p2.x - p0.x) *0.5;
+    const auto acc = ( p2.y - 2.0* p1.y + p0.y)/(delta*delta);
+    return PlotData::Point( (p2.x + p0.x)*0.5, acc );
 }
 
-bool Timeseries_2ndDerivative::updateCache()
+void DerivativeTransform::compute()
 {
-    size_t data_size = _source_data->size();
+    const size_t data_size = _source->size();
+    const size_t order = size_t(_order);
 
-    if( data_size <= 2)
+    if( data_size <= order )
     {
-        _cached_data.clear();
-        _bounding_box = QRectF();
-        return true;
+        _data.clear();
+        _last_repeats = 0;
+        return;
     }
 
-    data_size = data_size - 2;
-    _cached_data.resize( data_size );
+    // Find the last sample processed by the previous update. If it isn't
+    // there anymore, the source was modified in some other way than
+    // appending and trimming: start again from scratch.
+    size_t next = order;
+    bool found = false;
+    if( _last_repeats > 0 )
+    {
+        const size_t last = _source->lowerBound( _last_point.x ) + _last_repeats - 1;
+        if( last < data_size )
+        {
+            const auto& p = _source->at( last );
+            found = ( p.x == _last_point.x && p.y == _last_point.y );
+        }
+        next = std::max( next, last+1 );
+    }
 
-    for (size_t i=0; i < data_size; i++ )
+    if( found )
     {
-        const auto& p0 = _source_data->at( i );
-        const auto& p1 = _source_data->at( i+1 );
-        const auto& p2 = _source_data->at( i+2 );
-        const auto delta = (p2.x - p0.x) *0.5;
-        const auto acc = ( p2.y - 2.0* p1.y + p0.y)/(delta*delta);
-        QPointF p( (p2.x + p0.x)*0.5, acc );
-        _cached_data[i] = { p.x(), p.y() };
+        // samples were removed from the front of the source
+        const double front_x = derivativeAt( order ).x;
+        _data.popFront( _data.lowerBound( front_x ) );
+    }
+    else{
+        _data.clear();
+        next = order;
     }
 
-    calculateBoundingBox();
-    return true;
+    for (size_t i = next; i < data_size; i++ )
+    {
+        _data.pushBack( derivativeAt(i) );
+    }
+
+    _last_point = _source->back();
+    _last_repeats = 1;
+    while( _last_repeats < data_size &&
+           _source->at( data_size - 1 - _last_repeats ).x == _last_point.x )
+    {
+        _last_repeats++;
+    }
+}
+
+Timeseries_Derivative::Timeseries_Derivative(const PlotData *source_data, int order):
+    Timeseries_Shared( source_data,
+                       SharedTransform::get<DerivativeTransform>( source_data,
+                                                                  "derivative",
+                                                                  std::to_string(order),
+                                                                  source_data, order ) )
+{
 }
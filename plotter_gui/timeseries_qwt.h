@@ -1,7 +1,9 @@
 #ifndef PLOTDATA_QWT_H
 #define PLOTDATA_QWT_H
 
+#include <memory>
 #include "series_data.h"
+#include "shared_transform.h"
 #include "PlotJuggler/plotdata.h"
 
 class TimeseriesQwt: public DataSeriesBase
@@ -10,13 +12,45 @@ public:
 
     TimeseriesQwt(const PlotData *source_data, const PlotData* transformed_data);
 
+    QPointF sample( size_t i ) const override;
+
+    size_t size() const override;
+
+    void setRectOfInterest( const QRectF& rect ) override;
+
     PlotData::RangeValueOpt getVisualizationRangeY(PlotData::RangeTime range_X) override;
 
     nonstd::optional<QPointF> sampleFromTime(double t) override;
 
+    uint64_t sourceGeneration() override { return _source_data->generation(); }
+
 protected:
     const PlotData*  _source_data;
-    PlotData   _cached_data;
+
+private:
+
+    // When the visible part of the series has more samples than pixels, the
+    // painter receives only the first, min, max and last sample of each column.
+    void updateDownsampled() const;
+
+    struct DownsampleKey{
+        uint64_t generation; // samples modified in place keep size and range
+        size_t size;
+        double front_x;
+        double back_x;
+        QRectF rect;
+        int width;
+        double offset;
+        bool operator ==(const DownsampleKey& other) const;
+    };
+
+    QRectF _rect_of_interest;
+    mutable DownsampleKey _downsample_key;
+    mutable std::vector<QPointF> _downsampled;
+    mutable bool _use_downsampled;
+
+    // the tracker moves forward during playback
+    PlotData::IndexCursor _time_cursor;
 };
 
 //---------------------------------------------------------
@@ -27,35 +61,75 @@ public:
     Timeseries_NoTransform(const PlotData* source_data):
         TimeseriesQwt( source_data, source_data )
     {
-        updateCache();
+        updateCacheIfModified();
     }
 
      bool updateCache() override;
 
 };
 
-class Timeseries_1stDerivative: public TimeseriesQwt
+/// Displays the result of a SharedTransform.
+class Timeseries_Shared: public TimeseriesQwt
 {
 public:
-    Timeseries_1stDerivative(const PlotData* source_data):
-        TimeseriesQwt(source_data, &_cached_data)
-    {
-        updateCache();
-    }
+    Timeseries_Shared(const PlotData* source_data, std::shared_ptr<SharedTransform> transform);
 
-     bool updateCache() override;
+    bool updateCache() override;
+
+    uint64_t sourceGeneration() override { return _shared_transform->inputGeneration(); }
+
+private:
+    std::shared_ptr<SharedTransform> _shared_transform;
 };
 
-class Timeseries_2ndDerivative: public TimeseriesQwt
+/**
+ * Derivative of a series. Only the samples appended to the source since the
+ * previous update are processed; the derivative of the samples removed from
+ * the front of the source is removed too.
+ */
+class DerivativeTransform: public SharedTransform
 {
 public:
-    Timeseries_2ndDerivative(const PlotData* source_data):
-        TimeseriesQwt(source_data, &_cached_data)
-    {
-        updateCache();
-    }
+    DerivativeTransform(const PlotData* source, int order);
 
-     bool updateCache() override;
+    uint64_t inputGeneration() override { return _source->generation(); }
+
+protected:
+    void compute() override;
+
+private:
+    // derivative computed with the samples [last-order, last] of the source
+    PlotData::Point derivativeAt(size_t last) const;
+
+    const PlotData* _source;
+    const int _order;
+
+    // last sample of the source that was processed and how many samples
+    // before it (included) have the same timestamp. Zero if none.
+    PlotData::Point _last_point;
+    size_t _last_repeats;
+};
+
+class Timeseries_Derivative: public Timeseries_Shared
+{
+public:
+    Timeseries_Derivative(const PlotData* source_data, int order);
+};
+
+class Timeseries_1stDerivative: public Timeseries_Derivative
+{
+public:
+    Timeseries_1stDerivative(const PlotData* source_data):
+        Timeseries_Derivative(source_data, 1)
+    {}
+};
+
+class Timeseries_2ndDerivative: public Timeseries_Derivative
+{
+public:
+    Timeseries_2ndDerivative(const PlotData* source_data):
+        Timeseries_Derivative(source_data, 2)
+    {}
 };
 
 
@@ -1,5 +1,6 @@
 #include "lua_custom_function.h"
 #include "qml_custom_function.h"
+#include "native_custom_function.h"
 #include <QSettings>
 
 
@@ -19,6 +20,16 @@ CustomFunctionFactory(const std::string &linkedPlot,
 {
   QSettings settings;
   static bool is_qml = settings.value("CustomFunction/language", "qml").toString() == "qml";
+
+  // simple arithmetic expressions don't need a script engine
+  auto native = NativeCustomFunction::create( linkedPlot, snippet,
+                                              is_qml ? NativeCustomFunction::JAVASCRIPT :
+                                                       NativeCustomFunction::LUA );
+  if( native )
+  {
+    return std::move(native);
+  }
+
   if( is_qml)
   {
     return std::make_unique<QmlCustomFunction>( linkedPlot, snippet );
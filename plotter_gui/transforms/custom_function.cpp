@@ -1,5 +1,6 @@
 #include "custom_function.h"
 
+#include <array>
 #include <limits>
 #include <QFile>
 #include <QMessageBox>
@@ -16,7 +17,16 @@ CustomFunction::CustomFunction(const std::string &linkedPlot,
 
 void CustomFunction::clear()
 {
+  resetCursor();
   initEngine();
+  _has_state = false;
+}
+
+void CustomFunction::resetCursor()
+{
+  _cursor_source = nullptr;
+  _cursor_channels.clear();
+  _channel_cursors.clear();
 }
 
 QStringList CustomFunction::getChannelsFromFuntion(const QString& function)
@@ -100,6 +110,7 @@ void CustomFunction::calculateAndAdd(PlotDataMapRef &plotData)
 
     PlotData& dst_data = dst_data_it->second;
     dst_data.clear();
+    resetCursor();
 
     try{
         calculate(plotData, &dst_data);
@@ -108,22 +119,76 @@ void CustomFunction::calculateAndAdd(PlotDataMapRef &plotData)
     {
         if( newly_added )
         {
-            plotData.numeric.erase( dst_data_it );
+            plotData.eraseNumeric( dst_data_it );
         }
         std::rethrow_exception( std::current_exception() );
     }
 }
 
+void CustomFunction::resolveChannels(const PlotDataMapRef &plotData)
+{
+    // names are resolved only once
+    if( _resolved_map != &plotData )
+    {
+        _linked_plot_id = plotData.getID(_linked_plot_name);
+        _used_channels_id.clear();
+        for(const auto& channel: _used_channels)
+        {
+            _used_channels_id.push_back( plotData.getID(channel) );
+        }
+        _resolved_map = &plotData;
+    }
+}
+
+uint64_t CustomFunction::inputGeneration(const PlotDataMapRef &plotData)
+{
+    resolveChannels(plotData);
+
+    // removing a series restarts its generation, erase_count makes up for it
+    uint64_t generation = plotData.erase_count;
+    if( const PlotData* src_data = plotData.numericByID(_linked_plot_id) )
+    {
+        generation += src_data->generation();
+    }
+    for(auto channel_id: _used_channels_id)
+    {
+        if( const PlotData* chan_data = plotData.numericByID(channel_id) )
+        {
+            generation += chan_data->generation();
+        }
+    }
+    return generation;
+}
+
 void CustomFunction::calculate(const PlotDataMapRef &plotData, PlotData* dst_data)
 {
-    auto src_data_it = plotData.numeric.find(_linked_plot_name);
-    if(src_data_it == plotData.numeric.end())
+    calculate( inputs(plotData), dst_data );
+}
+
+CustomFunction::Inputs CustomFunction::inputs(const PlotDataMapRef &plotData)
+{
+    resolveChannels(plotData);
+
+    Inputs inputs;
+    inputs.source = plotData.numericByID(_linked_plot_id);
+    inputs.channels.reserve( _used_channels_id.size() );
+    for(auto channel_id: _used_channels_id)
+    {
+        inputs.channels.push_back( plotData.numericByID(channel_id) );
+    }
+    return inputs;
+}
+
+void CustomFunction::calculate(const Inputs &inputs, PlotData* dst_data,
+                               const std::atomic<bool>* cancel)
+{
+    if( !inputs.source )
     {
         // failed! keep it empty
         return;
     }
 
-    const PlotData& src_data = src_data_it->second;
+    const PlotData& src_data = *inputs.source;
     if( src_data.size() == 0)
     {
         return;
@@ -132,32 +197,124 @@ void CustomFunction::calculate(const PlotDataMapRef &plotData, PlotData* dst_dat
     // clean up old data
     dst_data->setMaximumRangeX( src_data.maximumRangeX() );
 
-    std::vector<const PlotData*> channel_data;
-    channel_data.reserve(_used_channels.size());
-
-    for(const auto& channel: _used_channels)
+    const std::vector<const PlotData*>& channel_data = inputs.channels;
+    for(const PlotData* chan_data: channel_data)
     {
-        auto it = plotData.numeric.find(channel);
-        if(it == plotData.numeric.end())
+        if( !chan_data )
         {
             throw std::runtime_error("Invalid channel name");
         }
-        const PlotData* chan_data = &(it->second);
-        channel_data.push_back(chan_data);
     }
 
-    double last_updated_stamp = -std::numeric_limits<double>::max();
-    if (dst_data->size() != 0)
+    if( _cursor_channels != channel_data )
     {
-        last_updated_stamp = dst_data->back().x;
+        _cursor_channels = channel_data;
+        _channel_cursors.clear();
+        for(const PlotData* chan_data: channel_data)
+        {
+            _channel_cursors.emplace_back( chan_data );
+        }
     }
 
-    for(size_t i=0; i < src_data.size(); ++i)
+    bool restart = false;
+    const size_t first = resumeIndex( src_data, *dst_data, &restart );
+    if( restart && _has_state )
+    {
+        // start again from a clean state
+        initEngine();
+        _has_state = false;
+    }
+
+    // The channels are sampled at the timestamps of each block of source points
+    // at once, instead of searching them point by point.
+    std::vector<std::array<double, PlotData::CHUNK_SIZE>> channel_samples( channel_data.size() );
+    std::vector<const double*> channel_values( channel_data.size() );
+    for(size_t chan = 0; chan < channel_data.size(); chan++)
+    {
+        channel_values[chan] = channel_samples[chan].data();
+    }
+
+    size_t index = first;
+    src_data.forEachSpan( first, src_data.size(),
+                         [&](const double* x, const double* y, size_t count)
+    {
+        if( cancel && cancel->load( std::memory_order_relaxed ) )
+        {
+            return;
+        }
+        for(size_t chan = 0; chan < channel_data.size(); chan++)
+        {
+            _channel_cursors[chan].sampleAt( x, count, channel_samples[chan].data(),
+                                             std::numeric_limits<double>::quiet_NaN() );
+        }
+        _has_state = true;
+        calculateBlock( src_data, index, x, y, count, channel_values, dst_data );
+        index += count;
+    });
+
+    if( index > 0 )
+    {
+        _cursor_source = &src_data;
+        _cursor_next = src_data.removedCount() + index;
+        _cursor_last_x = src_data.at(index-1).x;
+    }
+    _dst_was_empty = (dst_data->size() == 0);
+}
+
+size_t CustomFunction::resumeIndex(const PlotData &src_data, const PlotData &dst_data,
+                                   bool* restart)
+{
+    *restart = false;
+    // valid if the source lost only its oldest samples and nobody cleared the destination
+    if( _cursor_source == &src_data &&
+        (dst_data.size() != 0 || _dst_was_empty) &&
+        _cursor_next >= src_data.removedCount() )
+    {
+        const uint64_t index = _cursor_next - src_data.removedCount();
+        if( index == 0 )
+        {
+            // the last sample computed was removed
+            if( src_data.front().x > _cursor_last_x )
+            {
+                return 0;
+            }
+        }
+        else if( index <= src_data.size() && src_data.at(index-1).x == _cursor_last_x )
+        {
+            return index;
+        }
+    }
+
+    size_t first = 0;
+    if (dst_data.size() != 0)
+    {
+        const double last_updated_stamp = dst_data.back().x;
+        first = src_data.lowerBound( last_updated_stamp );
+        while( first < src_data.size() && src_data.at(first).x <= last_updated_stamp )
+        {
+            first++;
+        }
+    }
+    *restart = (dst_data.size() == 0);
+    return first;
+}
+
+void CustomFunction::calculateBlock(const PlotData &src_data,
+                                    size_t first_index,
+                                    const double*,
+                                    const double*,
+                                    size_t count,
+                                    const std::vector<const double*> &channel_values,
+                                    PlotData *dst_data)
+{
+    std::vector<double> point_channels( channel_values.size() );
+    for(size_t i = 0; i < count; i++)
     {
-        if( src_data.at(i).x > last_updated_stamp)
+        for(size_t chan = 0; chan < channel_values.size(); chan++)
         {
-            dst_data->pushBack( calculatePoint( src_data, channel_data, i ) );
+            point_channels[chan] = channel_values[chan][i];
         }
+        dst_data->pushBack( calculatePoint( src_data, point_channels, first_index + i ) );
     }
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <QWidget>
@@ -59,13 +60,60 @@ public:
 
     void calculate(const PlotDataMapRef &plotData, PlotData *dst_data);
 
+    /// The series read by calculate(); nullptr if they don't exist.
+    struct Inputs{
+        const PlotData* source;
+        std::vector<const PlotData*> channels;
+    };
+
+    /// Looks up the inputs in plotData. It is not thread-safe (see PlotDataMapRef::getID).
+    Inputs inputs(const PlotDataMapRef &plotData);
+
+    /**
+     * Same as calculate(), with the inputs resolved in advance: it can be called by
+     * another thread, provided that nobody else modifies the inputs or dst_data.
+     * If cancel becomes true, it stops after the current block of samples; the
+     * points computed so far are valid and the next call continues from there.
+     *
+     * Only the source samples added since the previous call are computed, and the
+     * state of the engine (global variables, filters) carries over. When the
+     * computation restarts from the first sample, the engine is initialized again.
+     */
+    void calculate(const Inputs &inputs, PlotData *dst_data,
+                   const std::atomic<bool>* cancel = nullptr);
+
+    /// The names of the series used with the syntax $$name$$, other than linkedPlotName().
+    const std::vector<std::string>& usedChannels() const { return _used_channels; }
+
+    /// False if the engine can only be used by the thread that created it.
+    virtual bool isThreadSafe() const { return true; }
+
+    /// Changes every time one of the series used by calculate() is modified.
+    uint64_t inputGeneration(const PlotDataMapRef &plotData);
+
     virtual void initEngine() = 0;
 
+    /// channel_values contains the value of each used channel at the time of the point.
     virtual PlotData::Point calculatePoint(
         const PlotData & src_data,
-        const std::vector<const PlotData *> & channels_data,
+        const std::vector<double> & channel_values,
         size_t point_index) = 0;
 
+    /**
+     * Compute the points of count consecutive samples of src_data, starting from
+     * first_index; x and y are their timestamps and values. channel_values[c][i]
+     * is the value of the channel c at the time x[i].
+     * The default implementation calls calculatePoint() for each sample.
+     */
+    virtual void calculateBlock(
+        const PlotData & src_data,
+        size_t first_index,
+        const double* x,
+        const double* y,
+        size_t count,
+        const std::vector<const double*> & channel_values,
+        PlotData* dst_data);
+
   protected:
 
     const std::string _linked_plot_name;
@@ -75,6 +123,32 @@ public:
     QString _function_replaced;
     std::vector<std::string> _used_channels;
     void createReplacedFunction(int index_offset);
+
+  private:
+    void resolveChannels(const PlotDataMapRef &plotData);
+
+    // Index of the first source sample not computed yet. restart is true if the
+    // computation starts from scratch.
+    size_t resumeIndex(const PlotData &src_data, const PlotData &dst_data, bool* restart);
+
+    void resetCursor();
+
+    // handles of _linked_plot_name and _used_channels in _resolved_map
+    const PlotDataMapRef* _resolved_map = nullptr;
+    PlotDataMapRef::SeriesID _linked_plot_id;
+    std::vector<PlotDataMapRef::SeriesID> _used_channels_id;
+
+    // Position in the source of the next sample to compute, stored as
+    // index + removedCount() to survive the removal of the oldest samples.
+    const PlotData* _cursor_source = nullptr;
+    uint64_t _cursor_next = 0;
+    double _cursor_last_x = 0;
+    bool _dst_was_empty = true;
+    // calculate() modified the state of the engine since initEngine()
+    bool _has_state = false;
+
+    std::vector<const PlotData*> _cursor_channels;
+    std::vector<PlotData::IndexCursor> _channel_cursors;
 };
 
 std::unique_ptr<CustomFunction>
@@ -0,0 +1,218 @@
+#include "custom_function_scheduler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <QCoreApplication>
+#include <QProgressDialog>
+#include <QtConcurrent>
+
+CustomFunctionScheduler::Task::Task(CustomFunction* function, PlotData* destination):
+    function(function),
+    destination(destination),
+    result( destination->snapshot() ),
+    pending_inputs(0),
+    started(false)
+{
+}
+
+CustomFunctionScheduler::CustomFunctionScheduler(const CustomPlotMap& custom_plots,
+                                                 PlotDataMapRef& plot_data):
+    _cancel(false)
+{
+    std::unordered_map<std::string, size_t> task_index;
+
+    for(const auto& it: custom_plots)
+    {
+        auto dst_it = plot_data.numeric.find( it.first );
+        if( dst_it == plot_data.numeric.end() )
+        {
+            continue;
+        }
+        task_index[ it.first ] = _tasks.size();
+        _tasks.emplace_back( it.second.get(), &dst_it->second );
+    }
+
+    for(size_t i = 0; i < _tasks.size(); i++)
+    {
+        Task& task = _tasks[i];
+        // the lookup in plot_data isn't thread-safe
+        task.inputs = task.function->inputs( plot_data );
+
+        std::vector<std::string> input_names = task.function->usedChannels();
+        input_names.push_back( task.function->linkedPlotName() );
+
+        for(const auto& name: input_names)
+        {
+            auto it = task_index.find( name );
+            if( it != task_index.end() && it->second != i )
+            {
+                _tasks[it->second].dependents.push_back( i );
+                task.pending_inputs++;
+            }
+        }
+    }
+}
+
+void CustomFunctionScheduler::execute(Task& task)
+{
+    try{
+        task.function->calculate( task.inputs, &task.result, &_cancel );
+    }
+    catch(std::exception& err)
+    {
+        task.error = err.what();
+    }
+    catch(...)
+    {
+        task.error = "unknown exception";
+    }
+}
+
+void CustomFunctionScheduler::finish(size_t index, std::deque<size_t>& ready)
+{
+    Task& task = _tasks[index];
+
+    if( task.error.empty() )
+    {
+        task.destination->swapData( task.result );
+        task.destination->setMaximumRangeX( task.result.maximumRangeX() );
+    }
+    else{
+        _errors.push_back( QString("%1: %2")
+                           .arg( QString::fromStdString( task.function->name() ) )
+                           .arg( QString::fromStdString( task.error ) ) );
+    }
+    // the previous data
+    task.result.clear();
+
+    for(size_t dependent: task.dependents)
+    {
+        Task& dependent_task = _tasks[dependent];
+        // pending_inputs is already zero if a cycle was broken
+        if( dependent_task.pending_inputs > 0 && --dependent_task.pending_inputs == 0 )
+        {
+            ready.push_back( dependent );
+        }
+    }
+}
+
+bool CustomFunctionScheduler::run(QWidget* parent)
+{
+    if( _tasks.empty() )
+    {
+        return true;
+    }
+
+    QProgressDialog progress_dialog( parent );
+    progress_dialog.setLabelText("Computing the custom plots... please wait");
+    progress_dialog.setWindowModality( Qt::ApplicationModal );
+    progress_dialog.setRange( 0, static_cast<int>(_tasks.size()) );
+    progress_dialog.setMinimumDuration( 500 );
+    progress_dialog.setAutoClose( true );
+    progress_dialog.setAutoReset( true );
+
+    std::deque<size_t> ready;
+    std::deque<size_t> gui_thread_tasks;
+    for(size_t i = 0; i < _tasks.size(); i++)
+    {
+        if( _tasks[i].pending_inputs == 0 ){
+            ready.push_back( i );
+        }
+    }
+
+    // indices of the tasks completed by the workers
+    std::mutex mutex;
+    std::condition_variable completed_cv;
+    std::vector<size_t> completed;
+
+    size_t running = 0;
+    size_t done = 0;
+
+    while( done < _tasks.size() )
+    {
+        if( !_cancel )
+        {
+            while( !ready.empty() )
+            {
+                const size_t index = ready.front();
+                ready.pop_front();
+                Task& task = _tasks[index];
+                task.started = true;
+                running++;
+
+                if( task.function->isThreadSafe() )
+                {
+                    QtConcurrent::run( [this, index, &mutex, &completed_cv, &completed]()
+                    {
+                        execute( _tasks[index] );
+                        std::lock_guard<std::mutex> lock(mutex);
+                        completed.push_back( index );
+                        completed_cv.notify_one();
+                    } );
+                }
+                else{
+                    gui_thread_tasks.push_back( index );
+                }
+            }
+        }
+        else if( running == 0 )
+        {
+            break;
+        }
+
+        std::vector<size_t> finished;
+        if( !gui_thread_tasks.empty() )
+        {
+            const size_t index = gui_thread_tasks.front();
+            gui_thread_tasks.pop_front();
+            execute( _tasks[index] );
+            finished.push_back( index );
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if( finished.empty() )
+            {
+                completed_cv.wait_for( lock, std::chrono::milliseconds(50),
+                                       [&completed]() { return !completed.empty(); } );
+            }
+            finished.insert( finished.end(), completed.begin(), completed.end() );
+            completed.clear();
+        }
+
+        for(size_t index: finished)
+        {
+            finish( index, ready );
+            running--;
+            done++;
+        }
+
+        // a cycle of custom plots that use each other: break it
+        if( running == 0 && ready.empty() && done < _tasks.size() )
+        {
+            for(size_t i = 0; i < _tasks.size(); i++)
+            {
+                if( !_tasks[i].started )
+                {
+                    _tasks[i].pending_inputs = 0;
+                    ready.push_back( i );
+                    break;
+                }
+            }
+        }
+
+        progress_dialog.setValue( static_cast<int>(done) );
+        // the user can't interact with the window until the (modal) dialog is visible
+        QCoreApplication::processEvents( progress_dialog.isVisible() ?
+                                             QEventLoop::AllEvents :
+                                             QEventLoop::ExcludeUserInputEvents );
+        if( progress_dialog.wasCanceled() )
+        {
+            _cancel = true;
+        }
+    }
+
+    progress_dialog.setValue( static_cast<int>(_tasks.size()) );
+    return !_cancel;
+}
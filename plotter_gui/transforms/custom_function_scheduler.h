@@ -0,0 +1,59 @@
+#ifndef CUSTOM_FUNCTION_SCHEDULER_H
+#define CUSTOM_FUNCTION_SCHEDULER_H
+
+#include <deque>
+#include <QStringList>
+#include "custom_function.h"
+
+class QWidget;
+
+/**
+ * Recomputes the custom plots, running the independent ones in parallel in the
+ * global QThreadPool. A custom plot that uses the series of another custom plot
+ * ($$name$$ or the linked plot) starts when that one is done. The functions with
+ * an engine that isn't thread-safe run in the GUI thread.
+ *
+ * Every function writes into a copy of its series (PlotData::snapshot()), swapped
+ * into the map by the GUI thread when it is done, therefore the widgets can be
+ * painted meanwhile. The map itself must not be modified until run() returns.
+ */
+class CustomFunctionScheduler
+{
+public:
+    CustomFunctionScheduler(const CustomPlotMap& custom_plots, PlotDataMapRef& plot_data);
+
+    /**
+     * A progress dialog, with a cancel button, is shown if it takes more than a
+     * moment. Returns false if it was canceled: the functions that were running
+     * keep the points computed so far, the others weren't executed.
+     */
+    bool run(QWidget* parent);
+
+    /// One entry "name: message" for each function that threw an exception.
+    const QStringList& errors() const { return _errors; }
+
+private:
+    struct Task{
+        Task(CustomFunction* function, PlotData* destination);
+
+        CustomFunction* function;
+        CustomFunction::Inputs inputs;
+        PlotData* destination;
+        PlotData result;
+        std::vector<size_t> dependents;
+        size_t pending_inputs;
+        bool started;
+        std::string error;
+    };
+
+    void execute(Task& task);
+
+    // GUI thread only
+    void finish(size_t index, std::deque<size_t>& ready);
+
+    std::deque<Task> _tasks;
+    std::atomic<bool> _cancel;
+    QStringList _errors;
+};
+
+#endif // CUSTOM_FUNCTION_SCHEDULER_H
@@ -3,27 +3,39 @@
 #include "lua_custom_function.h"
 #include "qml_custom_function.h"
 
-CustomTimeseries::CustomTimeseries(const PlotData *source_data,
-                                   const SnippetData &snippet,
-                                   PlotDataMapRef &mapped_data):
-    TimeseriesQwt( source_data, &_cached_data ),
+CustomTransform::CustomTransform(const PlotData *source_data,
+                                 const SnippetData &snippet,
+                                 const PlotDataMapRef &mapped_data):
+    _source_data(source_data),
     _mapped_data(mapped_data)
 {
     _transform = CustomFunctionFactory(source_data->name(), snippet);
-    updateCache();
 }
 
-bool CustomTimeseries::updateCache()
+uint64_t CustomTransform::inputGeneration()
+{
+    return _transform->inputGeneration(_mapped_data);
+}
+
+void CustomTransform::compute()
 {
     if(_source_data->size() == 0)
     {
-        _cached_data.clear();
-        _bounding_box = QRectF();
-        return true;
+        _data.clear();
+        return;
     }
+    _transform->calculate( _mapped_data, &_data );
+}
 
-    _transform->calculate( _mapped_data, &_cached_data );
-    calculateBoundingBox();
-
-    return true;
+// the snippets with the same code applied to the same series share the result
+CustomTimeseries::CustomTimeseries(const PlotData *source_data,
+                                   const SnippetData &snippet,
+                                   PlotDataMapRef &mapped_data):
+    Timeseries_Shared( source_data,
+                       SharedTransform::get<CustomTransform>(
+                           source_data,
+                           "custom::" + snippet.name.toStdString(),
+                           (snippet.globalVars + "\n" + snippet.equation).toStdString(),
+                           source_data, snippet, mapped_data ) )
+{
 }
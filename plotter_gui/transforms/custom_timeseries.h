@@ -5,19 +5,31 @@
 #include "custom_function.h"
 #include "PlotJuggler/plotdata.h"
 
-class CustomTimeseries: public TimeseriesQwt
+/// Result of a snippet applied to a series.
+class CustomTransform: public SharedTransform
 {
 public:
-    CustomTimeseries(const PlotData *source_data,
-                     const SnippetData &snippet,
-                     PlotDataMapRef& mapped_data);
+    CustomTransform(const PlotData *source_data,
+                    const SnippetData &snippet,
+                    const PlotDataMapRef& mapped_data);
 
-    bool updateCache() override;
+    uint64_t inputGeneration() override;
+
+protected:
+    void compute() override;
 
 private:
+    const PlotData* _source_data;
     std::unique_ptr<CustomFunction> _transform;
     const PlotDataMapRef& _mapped_data;
+};
 
+class CustomTimeseries: public Timeseries_Shared
+{
+public:
+    CustomTimeseries(const PlotData *source_data,
+                     const SnippetData &snippet,
+                     PlotDataMapRef& mapped_data);
 };
 
 #endif // CUSTOM_TIMESERIES_H
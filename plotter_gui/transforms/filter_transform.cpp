@@ -0,0 +1,279 @@
+#include "filter_transform.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+typedef FilterTransform::Filter Filter;
+
+// Window of the last samples, as a ring buffer
+class Window
+{
+public:
+    explicit Window(size_t size): _values( std::max<size_t>(1, size) ) { reset(); }
+
+    void reset() { _pos = 0; _count = 0; }
+
+    bool full() const { return _count == _values.size(); }
+
+    size_t count() const { return _count; }
+
+    /// Value that the next push() will overwrite, if full().
+    double oldest() const { return _values[_pos]; }
+
+    void push(double value)
+    {
+        _values[_pos] = value;
+        _pos = (_pos + 1 == _values.size()) ? 0 : _pos + 1;
+        _count = std::min( _count + 1, _values.size() );
+    }
+
+    // the sum is computed again periodically, to cancel the rounding errors
+    bool wrapped() const { return _pos == 0; }
+
+    double sum() const
+    {
+        double sum = 0;
+        for (size_t i=0; i<_count; i++) { sum += _values[i]; }
+        return sum;
+    }
+
+    const std::vector<double>& values() const { return _values; }
+
+private:
+    std::vector<double> _values;
+    size_t _pos;
+    size_t _count;
+};
+
+class MovingAverageFilter: public Filter
+{
+public:
+    MovingAverageFilter(size_t size, bool squared): _window(size), _squared(squared) { reset(); }
+
+    void reset() override { _window.reset(); _sum = 0; }
+
+    void process(const double*, const double* y, size_t count, double* output) override
+    {
+        for (size_t i=0; i<count; i++)
+        {
+            const double value = _squared ? y[i]*y[i] : y[i];
+            if( _window.full() ){
+                _sum -= _window.oldest();
+            }
+            _window.push( value );
+            _sum = _window.wrapped() ? _window.sum() : _sum + value;
+
+            const double mean = _sum / _window.count();
+            output[i] = _squared ? std::sqrt( std::max(0.0, mean) ) : mean;
+        }
+    }
+
+private:
+    Window _window;
+    const bool _squared;
+    double _sum;
+};
+
+class MedianFilter: public Filter
+{
+public:
+    MedianFilter(size_t size): _window(size) { reset(); }
+
+    void reset() override { _window.reset(); _sorted.clear(); }
+
+    void process(const double*, const double* y, size_t count, double* output) override
+    {
+        for (size_t i=0; i<count; i++)
+        {
+            if( _window.full() ){
+                _sorted.erase( std::lower_bound( _sorted.begin(), _sorted.end(), _window.oldest() ) );
+            }
+            _window.push( y[i] );
+            _sorted.insert( std::upper_bound( _sorted.begin(), _sorted.end(), y[i] ), y[i] );
+
+            const size_t half = _sorted.size() / 2;
+            output[i] = (_sorted.size() % 2 == 1) ? _sorted[half] :
+                                                    0.5 * (_sorted[half-1] + _sorted[half]);
+        }
+    }
+
+private:
+    Window _window;
+    std::vector<double> _sorted;
+};
+
+// first order, the parameter is the time constant
+class LowPassFilter: public Filter
+{
+public:
+    LowPassFilter(double time_constant): _time_constant(time_constant) { reset(); }
+
+    void reset() override { _first = true; }
+
+    void process(const double* x, const double* y, size_t count, double* output) override
+    {
+        for (size_t i=0; i<count; i++)
+        {
+            if( _first )
+            {
+                _output = y[i];
+                _first = false;
+            }
+            else{
+                const double dt = x[i] - _prev_x;
+                if( dt > 0 ){
+                    _output += (y[i] - _output) * dt / (_time_constant + dt);
+                }
+            }
+            _prev_x = x[i];
+            output[i] = _output;
+        }
+    }
+
+private:
+    const double _time_constant;
+    bool _first;
+    double _prev_x;
+    double _output;
+};
+
+// trapezoidal rule
+class IntegralFilter: public Filter
+{
+public:
+    IntegralFilter() { reset(); }
+
+    void reset() override { _first = true; _sum = 0; }
+
+    void process(const double* x, const double* y, size_t count, double* output) override
+    {
+        for (size_t i=0; i<count; i++)
+        {
+            if( !_first ){
+                _sum += 0.5 * (y[i] + _prev_y) * (x[i] - _prev_x);
+            }
+            _first = false;
+            _prev_x = x[i];
+            _prev_y = y[i];
+            output[i] = _sum;
+        }
+    }
+
+private:
+    bool _first;
+    double _sum;
+    double _prev_x;
+    double _prev_y;
+};
+
+std::unique_ptr<Filter> CreateFilter(const FilterInfo& info, double parameter)
+{
+    const size_t window = static_cast<size_t>( std::max( 1.0, std::round(parameter) ) );
+    switch( info.type )
+    {
+    case FilterInfo::MOVING_AVERAGE: return std::unique_ptr<Filter>( new MovingAverageFilter(window, false) );
+    case FilterInfo::RMS:            return std::unique_ptr<Filter>( new MovingAverageFilter(window, true) );
+    case FilterInfo::MEDIAN:         return std::unique_ptr<Filter>( new MedianFilter(window) );
+    case FilterInfo::LOW_PASS:       return std::unique_ptr<Filter>( new LowPassFilter(parameter) );
+    case FilterInfo::INTEGRAL:       return std::unique_ptr<Filter>( new IntegralFilter() );
+    }
+    return nullptr;
+}
+
+}
+
+const std::vector<FilterInfo>& BuiltinFilters()
+{
+    static const std::vector<FilterInfo> filters = {
+        { FilterInfo::MOVING_AVERAGE, "Moving Average", "Window (samples):", 10, 1, 100000, 0 },
+        { FilterInfo::MEDIAN,         "Median",         "Window (samples):", 5,  1, 10000,  0 },
+        { FilterInfo::RMS,            "RMS",            "Window (samples):", 10, 1, 100000, 0 },
+        { FilterInfo::LOW_PASS,       "Low Pass",       "Time constant (seconds):", 0.1, 0, 1e6, 4 },
+        { FilterInfo::INTEGRAL,       "Integral",       nullptr, 0, 0, 0, 0 }
+    };
+    return filters;
+}
+
+const FilterInfo* FindBuiltinFilter(const QString &name)
+{
+    for (const auto& filter: BuiltinFilters())
+    {
+        if( name == filter.name ){
+            return &filter;
+        }
+    }
+    return nullptr;
+}
+
+FilterTransform::FilterTransform(const PlotData *source, const FilterInfo &info, double parameter):
+    _source(source),
+    _filter( CreateFilter(info, parameter) ),
+    _has_cursor(false),
+    _cursor_next(0),
+    _cursor_last_x(0)
+{
+}
+
+FilterTransform::~FilterTransform() = default;
+
+void FilterTransform::compute()
+{
+    const PlotData& source = *_source;
+
+    if( source.size() == 0 )
+    {
+        _data.clear();
+        _filter->reset();
+        _has_cursor = false;
+        return;
+    }
+
+    // Find the first sample not processed yet. If the last one processed isn't
+    // where expected, the source was modified in some other way than appending
+    // and trimming: start again from scratch.
+    size_t first = 0;
+    bool resumed = false;
+    if( _has_cursor && _cursor_next >= source.removedCount() )
+    {
+        first = size_t( _cursor_next - source.removedCount() );
+        resumed = (first == 0) ? source.front().x > _cursor_last_x :
+                                 first <= source.size() && source.at(first-1).x == _cursor_last_x;
+    }
+
+    if( resumed )
+    {
+        // samples were removed from the front of the source
+        _data.popFront( _data.lowerBound( source.front().x ) );
+    }
+    else{
+        _data.clear();
+        _filter->reset();
+        first = 0;
+    }
+
+    std::array<double, PlotData::CHUNK_SIZE> output;
+    source.forEachSpan( first, source.size(), [&](const double* x, const double* y, size_t count)
+    {
+        _filter->process( x, y, count, output.data() );
+        for (size_t i=0; i<count; i++)
+        {
+            _data.pushBack( PlotData::Point( x[i], output[i] ) );
+        }
+    });
+
+    _has_cursor = true;
+    _cursor_next = source.removedCount() + source.size();
+    _cursor_last_x = source.back().x;
+}
+
+Timeseries_Filter::Timeseries_Filter(const PlotData *source_data,
+                                     const FilterInfo &info, double parameter):
+    Timeseries_Shared( source_data,
+                       SharedTransform::get<FilterTransform>( source_data,
+                                                              std::string("filter::") + info.name,
+                                                              std::to_string(parameter),
+                                                              source_data, info, parameter ) )
+{
+}
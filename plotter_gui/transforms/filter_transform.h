@@ -0,0 +1,69 @@
+#ifndef FILTER_TRANSFORM_H
+#define FILTER_TRANSFORM_H
+
+#include <memory>
+#include <vector>
+#include <QString>
+#include "timeseries_qwt.h"
+
+/// Description of a builtin filter and of its (optional) parameter.
+struct FilterInfo{
+    enum Type { MOVING_AVERAGE, MEDIAN, RMS, LOW_PASS, INTEGRAL };
+    Type type;
+    const char* name;      // ID of the transform, stored in the layout
+    const char* parameter; // label of the parameter, nullptr if it has none
+    double default_parameter;
+    double min_parameter;
+    double max_parameter;
+    int decimals;
+};
+
+const std::vector<FilterInfo>& BuiltinFilters();
+
+/// nullptr if name isn't the name of a builtin filter.
+const FilterInfo* FindBuiltinFilter(const QString& name);
+
+/**
+ * Applies a builtin filter to a series. Like DerivativeTransform, only the
+ * samples appended to the source since the previous update are processed, one
+ * block at a time, and the state of the filter carries over; the output of the
+ * samples removed from the front of the source is removed too.
+ */
+class FilterTransform: public SharedTransform
+{
+public:
+    FilterTransform(const PlotData* source, const FilterInfo& info, double parameter);
+
+    ~FilterTransform() override;
+
+    uint64_t inputGeneration() override { return _source->generation(); }
+
+    /// State of the filter, fed with blocks of consecutive samples.
+    class Filter
+    {
+    public:
+        virtual ~Filter() = default;
+        virtual void reset() = 0;
+        virtual void process(const double* x, const double* y, size_t count, double* output) = 0;
+    };
+
+protected:
+    void compute() override;
+
+private:
+    const PlotData* _source;
+    std::unique_ptr<Filter> _filter;
+
+    // next sample of the source to process, as index + removedCount()
+    bool _has_cursor;
+    uint64_t _cursor_next;
+    double _cursor_last_x;
+};
+
+class Timeseries_Filter: public Timeseries_Shared
+{
+public:
+    Timeseries_Filter(const PlotData* source_data, const FilterInfo& info, double parameter);
+};
+
+#endif // FILTER_TRANSFORM_H
@@ -1,5 +1,52 @@
 #include "lua_custom_function.h"
 
+namespace {
+// Filters that keep their state across the calls (and the streaming updates).
+// They are created in the global variables, for instance "speed = low_pass(0.5)",
+// and used in the function: "return speed(time, value)".
+const char* FILTERS_SCRIPT = R"(
+function integrator()
+  local sum, prev_time, prev_value = 0, nil, nil
+  return function(time, value)
+    if prev_time ~= nil then
+      sum = sum + 0.5 * (value + prev_value) * (time - prev_time)
+    end
+    prev_time, prev_value = time, value
+    return sum
+  end
+end
+
+function low_pass(time_constant)
+  local output, prev_time = nil, nil
+  return function(time, value)
+    if output == nil then
+      output = value
+    else
+      local dt = time - prev_time
+      output = output + (value - output) * dt / (time_constant + dt)
+    end
+    prev_time = time
+    return output
+  end
+end
+
+function moving_average(count)
+  local buffer, sum, pos, size = {}, 0, 0, 0
+  return function(value)
+    pos = pos % count + 1
+    if size < count then
+      size = size + 1
+    else
+      sum = sum - buffer[pos]
+    end
+    buffer[pos] = value
+    sum = sum + value
+    return sum / size
+  end
+end
+)";
+}
+
 
 LuaCustomFunction::LuaCustomFunction(const std::__cxx11::string &linkedPlot,
                                      const SnippetData &snippet):
@@ -13,44 +60,78 @@ void LuaCustomFunction::initEngine()
 {
   _lua_engine = std::unique_ptr<sol::state>( new sol::state() );
   _lua_engine->open_libraries();
+  _lua_engine->script(FILTERS_SCRIPT);
   _lua_engine->script(_global_vars.toStdString());
 
   QString calcMethodStr = QString("function calc(time, value, CHANNEL_VALUES) %1 end").arg(_function_replaced);
   _lua_engine->script(calcMethodStr.toStdString());
 
   _lua_function = (*_lua_engine)["calc"];
-}
 
+  // Same as calc(), but the values of the channels are arguments instead of a table.
+  QString function_args = _function_replaced;
+  QString channel_args;
+  QString channel_locals;
+  QString channel_values;
+  for (size_t chan = _used_channels.size(); chan > 0; chan--)
+  {
+    function_args.replace( QString("CHANNEL_VALUES[%1]").arg(chan), QString("CHANNEL_VALUE_%1").arg(chan) );
+  }
+  for (size_t chan = 1; chan <= _used_channels.size(); chan++)
+  {
+    channel_args   += QString(", CHANNEL_VALUE_%1").arg(chan);
+    channel_locals += QString("  local channel_%1 = channels[%1]\n").arg(chan);
+    channel_values += QString(", channel_%1[i]").arg(chan);
+  }
+  _lua_engine->script( QString("function calc_values(time, value%1) %2 end")
+                       .arg(channel_args, function_args).toStdString() );
+
+  // Calls calc_values() for each sample of a block; the arrays are filled by
+  // calculateBlock() and the results are written in place.
+  QString calcBlockStr = QString(
+    "function calc_block(count, time, value, channels)\n"
+    "  local calc = calc_values\n"
+    "%1"
+    "  for i = 1, count do\n"
+    "    local r1, r2, r3 = calc(time[i], value[i]%2)\n"
+    "    if r1 == nil or r3 ~= nil then\n"
+    "      error('Lua Engine : if you return an array, the size must be '..\n"
+    "            '2 (time/value pair) or 1 (value only)')\n"
+    "    elseif r2 == nil then\n"
+    "      value[i] = r1\n"
+    "    else\n"
+    "      time[i] = r1\n"
+    "      value[i] = r2\n"
+    "    end\n"
+    "  end\n"
+    "end\n").arg(channel_locals, channel_values);
+  _lua_engine->script( calcBlockStr.toStdString() );
+
+  _lua_block_function = (*_lua_engine)["calc_block"];
+
+  const int block_size = PlotData::CHUNK_SIZE;
+  _block_time  = _lua_engine->create_table( block_size, 0 );
+  _block_value = _lua_engine->create_table( block_size, 0 );
+  _block_channels = _lua_engine->create_table( int(_used_channels.size()), 0 );
+  for (size_t chan = 0; chan < _used_channels.size(); chan++)
+  {
+    _block_channels.raw_set( chan+1, _lua_engine->create_table( block_size, 0 ) );
+  }
+}
 
 PlotData::Point LuaCustomFunction::calculatePoint(
   const PlotData& src_data,
-  const std::vector<const PlotData*>& channels_data,
+  const std::vector<double>& channel_values,
   size_t point_index)
 {
-  _chan_values.resize(channels_data.size());
-
   const PlotData::Point &old_point = src_data.at(point_index);
 
-  for(int chan_index = 0; chan_index < channels_data.size(); chan_index++)
-  {
-    double value;
-    const auto& chan_data = channels_data[chan_index];
-    int index = chan_data->getIndexFromX(old_point.x);
-    if(index != -1){
-      value = chan_data->at(index).y;
-    }
-    else{
-      value = std::numeric_limits<double>::quiet_NaN();
-    }
-    _chan_values[chan_index] = value;
-  }
-
   PlotData::Point new_point;
   new_point.x = old_point.x;
 
   sol::function_result result = _lua_function( old_point.x,
                                               old_point.y,
-                                              _chan_values );
+                                              channel_values );
 
   if( result.return_count() == 2 )
   {
@@ -68,3 +149,54 @@ PlotData::Point LuaCustomFunction::calculatePoint(
   }
   return new_point;
 }
+
+void LuaCustomFunction::calculateBlock(const PlotData &,
+                                       size_t,
+                                       const double* x,
+                                       const double* y,
+                                       size_t count,
+                                       const std::vector<const double*> &channel_values,
+                                       PlotData *dst_data)
+{
+  lua_State* L = _lua_engine->lua_state();
+
+  // the stack is restored also when sol throws because of an error in Lua
+  struct RestoreStack{
+    lua_State* L;
+    int top;
+    ~RestoreStack() { lua_settop( L, top ); }
+  } restore_stack{ L, lua_gettop(L) };
+
+  // the table is on top of the stack
+  auto fillArray = [L, count](const double* values)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      lua_pushnumber( L, values[i] );
+      lua_rawseti( L, -2, lua_Integer(i+1) );
+    }
+  };
+
+  _block_time.push();
+  fillArray( x );
+  _block_value.push();
+  fillArray( y );
+  _block_channels.push();
+  for (size_t chan = 0; chan < channel_values.size(); chan++)
+  {
+    lua_rawgeti( L, -1, lua_Integer(chan+1) );
+    fillArray( channel_values[chan] );
+    lua_pop( L, 1 );
+  }
+  lua_pop( L, 1 );
+
+  _lua_block_function( count, _block_time, _block_value, _block_channels );
+
+  for (size_t i = 0; i < count; i++)
+  {
+    lua_rawgeti( L, -2, lua_Integer(i+1) );
+    lua_rawgeti( L, -2, lua_Integer(i+1) );
+    dst_data->pushBack( { lua_tonumber( L, -2 ), lua_tonumber( L, -1 ) } );
+    lua_pop( L, 2 );
+  }
+}
@@ -13,13 +13,27 @@ public:
   void initEngine() override;
 
   virtual PlotData::Point calculatePoint(const PlotData & src_data,
-                                         const std::vector<const PlotData *> & channels_data,
+                                         const std::vector<double> & channel_values,
                                          size_t point_index) override;
+
+  /// A single call to Lua computes the whole block.
+  void calculateBlock(const PlotData & src_data,
+                      size_t first_index,
+                      const double* x,
+                      const double* y,
+                      size_t count,
+                      const std::vector<const double*> & channel_values,
+                      PlotData* dst_data) override;
 private:
 
   std::unique_ptr<sol::state> _lua_engine;
   sol::function _lua_function;
-  std::vector<double> _chan_values;
+
+  // arrays of calc_block, reused by each block
+  sol::function _lua_block_function;
+  sol::table _block_time;
+  sol::table _block_value;
+  sol::table _block_channels;
 };
 
 #endif // LUA_CUSTOM_FUNCTION_H
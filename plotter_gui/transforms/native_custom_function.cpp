@@ -0,0 +1,677 @@
+#include "native_custom_function.h"
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+typedef NativeCustomFunction::OpCode OpCode;
+typedef NativeCustomFunction::Instruction Instruction;
+
+//------------- operations on a single value --------------
+
+double modLua(double a, double b)
+{
+  // same as luai_nummod
+  double m = std::fmod(a, b);
+  if( m*b < 0 )
+  {
+    m += b;
+  }
+  return m;
+}
+
+double powJS(double a, double b)
+{
+  if( std::isnan(b) || (std::isinf(b) && std::fabs(a) == 1.0) )
+  {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  return std::pow(a, b);
+}
+
+double minJS(double a, double b)
+{
+  return (std::isnan(a) || std::isnan(b)) ? std::numeric_limits<double>::quiet_NaN() : std::min(a, b);
+}
+
+double maxJS(double a, double b)
+{
+  return (std::isnan(a) || std::isnan(b)) ? std::numeric_limits<double>::quiet_NaN() : std::max(a, b);
+}
+
+double roundJS(double a)
+{
+  const double r = std::floor(a);
+  return (a - r >= 0.5) ? r + 1.0 : r;
+}
+
+double logLua(double x, double base)
+{
+  if( base == 2.0 ) return std::log2(x);
+  if( base == 10.0 ) return std::log10(x);
+  return std::log(x) / std::log(base);
+}
+
+double apply(const Instruction& ins, double a, double b)
+{
+  switch( ins.op )
+  {
+  case OpCode::ADD: return a + b;
+  case OpCode::SUB: return a - b;
+  case OpCode::MUL: return a * b;
+  case OpCode::DIV: return a / b;
+  case OpCode::NEG: return -a;
+  case OpCode::MOD_JS:  return std::fmod(a, b);
+  case OpCode::MOD_LUA: return modLua(a, b);
+  case OpCode::POW:     return std::pow(a, b);
+  case OpCode::MIN_JS:  return minJS(a, b);
+  case OpCode::MAX_JS:  return maxJS(a, b);
+  case OpCode::MIN_LUA: return (b < a) ? b : a;
+  case OpCode::MAX_LUA: return (a < b) ? b : a;
+  case OpCode::ABS:  return std::fabs(a);
+  case OpCode::SQRT: return std::sqrt(a);
+  case OpCode::ROUND_JS:  return roundJS(a);
+  case OpCode::FUNCTION1: return ins.function1(a);
+  case OpCode::FUNCTION2: return ins.function2(a, b);
+  }
+  return 0;
+}
+
+//------------- operations on a block --------------
+
+template <typename F> inline
+void applyBlock(double* dst, const double* a, const double* b, size_t count, F f)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    dst[i] = f( a[i], b[i] );
+  }
+}
+
+void applyBlock(const Instruction& ins, double* dst, const double* a, const double* b, size_t count)
+{
+  // the common operations are written as plain loops, that the compiler can vectorize
+  switch( ins.op )
+  {
+  case OpCode::ADD: applyBlock( dst, a, b, count, [](double x, double y) { return x + y; } ); break;
+  case OpCode::SUB: applyBlock( dst, a, b, count, [](double x, double y) { return x - y; } ); break;
+  case OpCode::MUL: applyBlock( dst, a, b, count, [](double x, double y) { return x * y; } ); break;
+  case OpCode::DIV: applyBlock( dst, a, b, count, [](double x, double y) { return x / y; } ); break;
+  case OpCode::NEG: applyBlock( dst, a, b, count, [](double x, double)   { return -x; } ); break;
+  case OpCode::ABS: applyBlock( dst, a, b, count, [](double x, double)   { return std::fabs(x); } ); break;
+  case OpCode::SQRT: applyBlock( dst, a, b, count, [](double x, double)  { return std::sqrt(x); } ); break;
+  default:
+    applyBlock( dst, a, b, count, [&ins](double x, double y) { return apply(ins, x, y); } );
+  }
+}
+
+//------------- parser --------------
+
+struct Node;
+typedef std::unique_ptr<Node> NodePtr;
+
+struct Node{
+  enum Kind { CONSTANT, INPUT, OPERATION };
+  Kind kind;
+  double constant;
+  int input; // 0: time, 1: value, 2+N: channel N
+  Instruction instruction;
+  std::vector<NodePtr> args;
+};
+
+NodePtr makeConstant(double value)
+{
+  NodePtr node( new Node() );
+  node->kind = Node::CONSTANT;
+  node->constant = value;
+  return node;
+}
+
+NodePtr makeInput(int input)
+{
+  NodePtr node( new Node() );
+  node->kind = Node::INPUT;
+  node->input = input;
+  return node;
+}
+
+NodePtr makeOperation(Instruction instruction, NodePtr a, NodePtr b = NodePtr())
+{
+  // constant folding
+  if( a->kind == Node::CONSTANT && (!b || b->kind == Node::CONSTANT) )
+  {
+    return makeConstant( apply( instruction, a->constant, b ? b->constant : 0.0 ) );
+  }
+  NodePtr node( new Node() );
+  node->kind = Node::OPERATION;
+  node->instruction = instruction;
+  node->args.push_back( std::move(a) );
+  if( b )
+  {
+    node->args.push_back( std::move(b) );
+  }
+  return node;
+}
+
+Instruction makeInstruction(OpCode op,
+                            double (*function1)(double) = nullptr,
+                            double (*function2)(double, double) = nullptr)
+{
+  return { op, 0, 0, 0, function1, function2 };
+}
+
+// Recursive descent parser; anything not supported throws and the snippet
+// is given to the script engine instead.
+class Parser
+{
+public:
+  Parser(const std::string& text, NativeCustomFunction::Language language, size_t channels_count):
+    _text(text), _pos(0), _language(language), _channels_count(channels_count)
+  {}
+
+  NodePtr parseFunction()
+  {
+    if( nextToken() != "return" )
+    {
+      fail();
+    }
+    NodePtr expression = parseSum();
+    std::string token = nextToken();
+    if( token == ";" )
+    {
+      token = nextToken();
+    }
+    if( !token.empty() )
+    {
+      fail();
+    }
+    return expression;
+  }
+
+private:
+  [[noreturn]] void fail()
+  {
+    throw std::runtime_error("expression not supported");
+  }
+
+  std::string peekToken()
+  {
+    const size_t pos = _pos;
+    std::string token = nextToken();
+    _pos = pos;
+    return token;
+  }
+
+  void expect(const char* expected)
+  {
+    if( nextToken() != expected )
+    {
+      fail();
+    }
+  }
+
+  std::string nextToken()
+  {
+    while( _pos < _text.size() && std::isspace( static_cast<unsigned char>(_text[_pos]) ) )
+    {
+      _pos++;
+    }
+    if( _pos >= _text.size() )
+    {
+      return std::string();
+    }
+    const size_t start = _pos;
+    const char c = _text[_pos];
+
+    auto isDigit = [this](size_t pos)
+    {
+      return pos < _text.size() && std::isdigit( static_cast<unsigned char>(_text[pos]) );
+    };
+
+    if( isDigit(_pos) || (c == '.' && isDigit(_pos+1)) )
+    {
+      while( isDigit(_pos) || (_pos < _text.size() && _text[_pos] == '.') )
+      {
+        _pos++;
+      }
+      if( _pos < _text.size() && (_text[_pos] == 'e' || _text[_pos] == 'E') )
+      {
+        _pos++;
+        if( _pos < _text.size() && (_text[_pos] == '+' || _text[_pos] == '-') )
+        {
+          _pos++;
+        }
+        while( isDigit(_pos) )
+        {
+          _pos++;
+        }
+      }
+    }
+    else if( std::isalpha( static_cast<unsigned char>(c) ) || c == '_' )
+    {
+      while( _pos < _text.size() &&
+             (std::isalnum( static_cast<unsigned char>(_text[_pos]) ) || _text[_pos] == '_') )
+      {
+        _pos++;
+      }
+    }
+    else if( std::string("+-*/%^(),[].;").find(c) != std::string::npos )
+    {
+      _pos++;
+      // "--" is a comment in Lua and a decrement in JavaScript, "**" is not ES5
+      if( _pos < _text.size() && (c == '-' || c == '*') && _text[_pos] == c )
+      {
+        fail();
+      }
+    }
+    else{
+      fail();
+    }
+    return _text.substr( start, _pos - start );
+  }
+
+  NodePtr parseSum()
+  {
+    NodePtr left = parseProduct();
+    while( true )
+    {
+      const std::string op = peekToken();
+      if( op != "+" && op != "-" )
+      {
+        return left;
+      }
+      nextToken();
+      NodePtr right = parseProduct();
+      left = makeOperation( makeInstruction( op == "+" ? OpCode::ADD : OpCode::SUB ),
+                            std::move(left), std::move(right) );
+    }
+  }
+
+  NodePtr parseProduct()
+  {
+    NodePtr left = parseUnary();
+    while( true )
+    {
+      const std::string op = peekToken();
+      OpCode code;
+      if( op == "*" ) code = OpCode::MUL;
+      else if( op == "/" ) code = OpCode::DIV;
+      else if( op == "%" ) code = (_language == NativeCustomFunction::LUA) ? OpCode::MOD_LUA : OpCode::MOD_JS;
+      else return left;
+
+      nextToken();
+      NodePtr right = parseUnary();
+      left = makeOperation( makeInstruction(code), std::move(left), std::move(right) );
+    }
+  }
+
+  NodePtr parseUnary()
+  {
+    const std::string op = peekToken();
+    if( op == "-" )
+    {
+      nextToken();
+      return makeOperation( makeInstruction(OpCode::NEG), parseUnary() );
+    }
+    if( op == "+" && _language == NativeCustomFunction::JAVASCRIPT )
+    {
+      nextToken();
+      return parseUnary();
+    }
+    return parsePower();
+  }
+
+  NodePtr parsePower()
+  {
+    NodePtr base = parsePrimary();
+    const std::string op = peekToken();
+    if( op == "^" )
+    {
+      // bitwise XOR in JavaScript
+      if( _language != NativeCustomFunction::LUA )
+      {
+        fail();
+      }
+      nextToken();
+      // right associative, binds tighter than the unary minus on its left
+      return makeOperation( makeInstruction(OpCode::POW), std::move(base), parseUnary() );
+    }
+    return base;
+  }
+
+  NodePtr parsePrimary()
+  {
+    const std::string token = nextToken();
+    if( token.empty() )
+    {
+      fail();
+    }
+    if( std::isdigit( static_cast<unsigned char>(token[0]) ) || token[0] == '.' )
+    {
+      char* end = nullptr;
+      const double value = std::strtod( token.c_str(), &end );
+      if( end != token.c_str() + token.size() )
+      {
+        fail();
+      }
+      return makeConstant(value);
+    }
+    if( token == "(" )
+    {
+      NodePtr expression = parseSum();
+      expect(")");
+      return expression;
+    }
+    if( token == "time" )
+    {
+      return makeInput(0);
+    }
+    if( token == "value" )
+    {
+      return makeInput(1);
+    }
+    if( token == "CHANNEL_VALUES" )
+    {
+      expect("[");
+      const std::string index = nextToken();
+      expect("]");
+      char* end = nullptr;
+      const unsigned long channel = std::strtoul( index.c_str(), &end, 10 );
+      if( index.empty() || end != index.c_str() + index.size() || channel >= _channels_count )
+      {
+        fail();
+      }
+      return makeInput( 2 + int(channel) );
+    }
+
+    // math library
+    std::string name = token;
+    if( (_language == NativeCustomFunction::LUA && token == "math") ||
+        (_language == NativeCustomFunction::JAVASCRIPT && token == "Math") )
+    {
+      expect(".");
+      name = nextToken();
+    }
+    else if( _language == NativeCustomFunction::LUA )
+    {
+      fail(); // in JavaScript the Math prefix is optional: calc() uses "with(Math)"
+    }
+    return (_language == NativeCustomFunction::LUA) ? parseLuaMath(name) : parseJavascriptMath(name);
+  }
+
+  std::vector<NodePtr> parseArguments()
+  {
+    std::vector<NodePtr> args;
+    expect("(");
+    if( peekToken() == ")" )
+    {
+      nextToken();
+      return args;
+    }
+    while( true )
+    {
+      args.push_back( parseSum() );
+      const std::string token = nextToken();
+      if( token == ")" )
+      {
+        return args;
+      }
+      if( token != "," )
+      {
+        fail();
+      }
+    }
+  }
+
+  NodePtr call(Instruction instruction, std::vector<NodePtr>& args, size_t expected_args)
+  {
+    if( args.size() != expected_args )
+    {
+      fail();
+    }
+    return makeOperation( instruction, std::move(args[0]),
+                          expected_args == 2 ? std::move(args[1]) : NodePtr() );
+  }
+
+  // min and max take any number of arguments
+  NodePtr fold(OpCode op, std::vector<NodePtr>& args)
+  {
+    if( args.empty() )
+    {
+      fail();
+    }
+    NodePtr result = std::move(args[0]);
+    for (size_t i = 1; i < args.size(); i++)
+    {
+      result = makeOperation( makeInstruction(op), std::move(result), std::move(args[i]) );
+    }
+    return result;
+  }
+
+  NodePtr parseJavascriptMath(const std::string& name)
+  {
+    static const std::map<std::string, double> constants = {
+      {"PI", M_PI}, {"E", M_E}, {"LN2", M_LN2}, {"LN10", M_LN10},
+      {"LOG2E", M_LOG2E}, {"LOG10E", M_LOG10E}, {"SQRT2", M_SQRT2}, {"SQRT1_2", M_SQRT1_2} };
+    static const std::map<std::string, double(*)(double)> functions = {
+      {"acos", std::acos}, {"asin", std::asin}, {"atan", std::atan}, {"ceil", std::ceil},
+      {"cos", std::cos}, {"exp", std::exp}, {"floor", std::floor}, {"log", std::log},
+      {"sin", std::sin}, {"tan", std::tan} };
+
+    auto constant = constants.find(name);
+    if( constant != constants.end() )
+    {
+      return makeConstant( constant->second );
+    }
+    std::vector<NodePtr> args = parseArguments();
+
+    auto function = functions.find(name);
+    if( function != functions.end() )
+    {
+      return call( makeInstruction(OpCode::FUNCTION1, function->second), args, 1 );
+    }
+    if( name == "abs" )   return call( makeInstruction(OpCode::ABS), args, 1 );
+    if( name == "sqrt" )  return call( makeInstruction(OpCode::SQRT), args, 1 );
+    if( name == "round" ) return call( makeInstruction(OpCode::ROUND_JS), args, 1 );
+    if( name == "atan2" ) return call( makeInstruction(OpCode::FUNCTION2, nullptr, std::atan2), args, 2 );
+    if( name == "pow" )   return call( makeInstruction(OpCode::FUNCTION2, nullptr, powJS), args, 2 );
+    if( name == "min" )   return fold( OpCode::MIN_JS, args );
+    if( name == "max" )   return fold( OpCode::MAX_JS, args );
+    fail();
+  }
+
+  NodePtr parseLuaMath(const std::string& name)
+  {
+    static const std::map<std::string, double(*)(double)> functions = {
+      {"acos", std::acos}, {"asin", std::asin}, {"ceil", std::ceil}, {"cos", std::cos},
+      {"exp", std::exp}, {"floor", std::floor}, {"sin", std::sin}, {"tan", std::tan} };
+
+    if( name == "pi" )
+    {
+      return makeConstant( M_PI );
+    }
+    if( name == "huge" )
+    {
+      return makeConstant( std::numeric_limits<double>::infinity() );
+    }
+    std::vector<NodePtr> args = parseArguments();
+
+    auto function = functions.find(name);
+    if( function != functions.end() )
+    {
+      return call( makeInstruction(OpCode::FUNCTION1, function->second), args, 1 );
+    }
+    if( name == "abs" )  return call( makeInstruction(OpCode::ABS), args, 1 );
+    if( name == "sqrt" ) return call( makeInstruction(OpCode::SQRT), args, 1 );
+    if( name == "fmod" ) return call( makeInstruction(OpCode::FUNCTION2, nullptr, std::fmod), args, 2 );
+    if( name == "atan" )
+    {
+      return ( args.size() == 2 ) ?
+            call( makeInstruction(OpCode::FUNCTION2, nullptr, std::atan2), args, 2 ) :
+            call( makeInstruction(OpCode::FUNCTION1, std::atan), args, 1 );
+    }
+    if( name == "log" )
+    {
+      return ( args.size() == 2 ) ?
+            call( makeInstruction(OpCode::FUNCTION2, nullptr, logLua), args, 2 ) :
+            call( makeInstruction(OpCode::FUNCTION1, std::log), args, 1 );
+    }
+    if( name == "min" ) return fold( OpCode::MIN_LUA, args );
+    if( name == "max" ) return fold( OpCode::MAX_LUA, args );
+    fail();
+  }
+
+  const std::string& _text;
+  size_t _pos;
+  const NativeCustomFunction::Language _language;
+  const size_t _channels_count;
+};
+
+//------------- code generation --------------
+
+struct Compiler
+{
+  std::vector<Instruction> program;
+  std::vector<double> constants;
+  int first_constant;
+  int temporaries = 0;
+
+  // constants are numbered in the same order by both passes
+  void collectConstants(const Node& node)
+  {
+    if( node.kind == Node::CONSTANT )
+    {
+      constants.push_back( node.constant );
+    }
+    for(const auto& arg: node.args)
+    {
+      collectConstants( *arg );
+    }
+  }
+
+  // returns the operand containing the result of the node; the result of the
+  // nodes at the given depth are stored in the temporary register "depth"
+  int generate(const Node& node, int depth, int& next_constant)
+  {
+    switch( node.kind )
+    {
+    case Node::CONSTANT: return first_constant + next_constant++;
+    case Node::INPUT:    return node.input;
+    case Node::OPERATION: break;
+    }
+    Instruction ins = node.instruction;
+    ins.a = generate( *node.args[0], depth, next_constant );
+    ins.b = ( node.args.size() > 1 ) ? generate( *node.args[1], depth + 1, next_constant ) : ins.a;
+    ins.dst = first_constant + int(constants.size()) + depth;
+    temporaries = std::max( temporaries, depth + 1 );
+    program.push_back( ins );
+    return ins.dst;
+  }
+};
+
+} // end namespace
+
+//--------------------------------------------------------
+
+NativeCustomFunction::NativeCustomFunction(const std::string &linkedPlot,
+                                           const SnippetData &snippet):
+  CustomFunction(linkedPlot, snippet)
+{
+}
+
+std::unique_ptr<NativeCustomFunction> NativeCustomFunction::create(const std::string &linkedPlot,
+                                                                   const SnippetData &snippet,
+                                                                   Language language)
+{
+  if( !snippet.globalVars.trimmed().isEmpty() )
+  {
+    return nullptr;
+  }
+
+  std::unique_ptr<NativeCustomFunction> function( new NativeCustomFunction(linkedPlot, snippet) );
+  Compiler compiler;
+  int result = 0;
+  try{
+    function->createReplacedFunction(0);
+    const std::string text = function->_function_replaced.toStdString();
+    const size_t channels_count = function->_used_channels.size();
+
+    NodePtr root = Parser( text, language, channels_count ).parseFunction();
+
+    compiler.first_constant = 2 + int(channels_count);
+    compiler.collectConstants( *root );
+    int next_constant = 0;
+    result = compiler.generate( *root, 0, next_constant );
+  }
+  catch(std::runtime_error&)
+  {
+    return nullptr;
+  }
+
+  function->_program = std::move( compiler.program );
+  function->_result = result;
+
+  // inputs are set by evaluate(), constants are written once
+  const size_t first_register = size_t(compiler.first_constant);
+  function->_first_register = first_register;
+  function->_registers.resize( compiler.constants.size() + size_t(compiler.temporaries) );
+  function->_operands.resize( first_register + function->_registers.size(), nullptr );
+  for (size_t i = 0; i < function->_registers.size(); i++)
+  {
+    function->_operands[first_register + i] = function->_registers[i].data();
+  }
+  for (size_t i = 0; i < compiler.constants.size(); i++)
+  {
+    function->_registers[i].fill( compiler.constants[i] );
+  }
+  return function;
+}
+
+const double* NativeCustomFunction::evaluate(const double* x, const double* y, size_t count,
+                                             const std::vector<const double*> &channel_values)
+{
+  _operands[0] = x;
+  _operands[1] = y;
+  for (size_t chan = 0; chan < channel_values.size(); chan++)
+  {
+    _operands[2 + chan] = channel_values[chan];
+  }
+  for(const auto& ins: _program)
+  {
+    double* dst = _registers[ size_t(ins.dst) - _first_register ].data();
+    applyBlock( ins, dst, _operands[ins.a], _operands[ins.b], count );
+  }
+  return _operands[_result];
+}
+
+PlotData::Point NativeCustomFunction::calculatePoint(const PlotData &src_data,
+                                                     const std::vector<double> &channel_values,
+                                                     size_t point_index)
+{
+  const PlotData::Point point = src_data.at(point_index);
+  std::vector<const double*> channels;
+  for(const double& value: channel_values)
+  {
+    channels.push_back( &value );
+  }
+  return { point.x, *evaluate( &point.x, &point.y, 1, channels ) };
+}
+
+void NativeCustomFunction::calculateBlock(const PlotData &,
+                                          size_t,
+                                          const double* x,
+                                          const double* y,
+                                          size_t count,
+                                          const std::vector<const double*> &channel_values,
+                                          PlotData *dst_data)
+{
+  const double* result = evaluate( x, y, count, channel_values );
+  for (size_t i = 0; i < count; i++)
+  {
+    dst_data->pushBack( { x[i], result[i] } );
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef NATIVE_CUSTOM_FUNCTION_H
+#define NATIVE_CUSTOM_FUNCTION_H
+
+#include <array>
+#include "custom_function.h"
+
+/**
+ * Evaluates, without a script engine, the snippets made of a single
+ * arithmetic expression, such as "return sqrt($$a$$*$$a$$ + $$b$$*$$b$$)".
+ *
+ * The expression is compiled into a list of instructions, each one applied
+ * to a whole block of samples at once. The syntax and the semantic follow
+ * the language of the engine it replaces (JavaScript or Lua).
+ */
+class NativeCustomFunction: public CustomFunction
+{
+public:
+  enum Language { JAVASCRIPT, LUA };
+
+  /// Returns nullptr if the snippet can't be evaluated natively.
+  static std::unique_ptr<NativeCustomFunction> create(const std::string &linkedPlot,
+                                                      const SnippetData &snippet,
+                                                      Language language);
+
+  void initEngine() override {}
+
+  PlotData::Point calculatePoint(const PlotData & src_data,
+                                 const std::vector<double> & channel_values,
+                                 size_t point_index) override;
+
+  void calculateBlock(const PlotData & src_data,
+                      size_t first_index,
+                      const double* x,
+                      const double* y,
+                      size_t count,
+                      const std::vector<const double*> & channel_values,
+                      PlotData* dst_data) override;
+
+  enum OpCode {
+    ADD, SUB, MUL, DIV, NEG,
+    MOD_JS, MOD_LUA, POW,
+    MIN_JS, MAX_JS, MIN_LUA, MAX_LUA,
+    ABS, SQRT, ROUND_JS,
+    FUNCTION1, FUNCTION2
+  };
+
+  /// dst = op(a, b). Operands are indices in the table built by evaluate().
+  struct Instruction{
+    OpCode op;
+    int dst;
+    int a;
+    int b;
+    double (*function1)(double);
+    double (*function2)(double, double);
+  };
+
+private:
+  NativeCustomFunction(const std::string &linkedPlot,
+                       const SnippetData &snippet);
+
+  // the result of the expression for count samples
+  const double* evaluate(const double* x, const double* y, size_t count,
+                         const std::vector<const double*> & channel_values);
+
+  enum{ BLOCK_SIZE = PlotData::CHUNK_SIZE };
+
+  std::vector<Instruction> _program;
+  int _result;
+
+  // operands: time, value, channels, constants, temporaries
+  std::vector<const double*> _operands;
+  std::vector<std::array<double, BLOCK_SIZE>> _registers;
+  size_t _first_register;
+};
+
+#endif // NATIVE_CUSTOM_FUNCTION_H
@@ -1,5 +1,55 @@
 #include "qml_custom_function.h"
 
+namespace {
+// Filters that keep their state across the calls (and the streaming updates).
+// They are created in the global variables, for instance "var speed = lowPass(0.5)",
+// and used in the function: "return speed(time, value)".
+const char* FILTERS_SCRIPT = R"(
+function integrator() {
+  var sum = 0, prevTime = null, prevValue = 0;
+  return function(time, value) {
+    if (prevTime !== null) {
+      sum += 0.5 * (value + prevValue) * (time - prevTime);
+    }
+    prevTime = time;
+    prevValue = value;
+    return sum;
+  };
+}
+
+function lowPass(timeConstant) {
+  var output = null, prevTime = 0;
+  return function(time, value) {
+    if (output === null) {
+      output = value;
+    }
+    else {
+      var dt = time - prevTime;
+      output += (value - output) * dt / (timeConstant + dt);
+    }
+    prevTime = time;
+    return output;
+  };
+}
+
+function movingAverage(count) {
+  var buffer = [], sum = 0, pos = 0;
+  return function(value) {
+    if (buffer.length < count) {
+      buffer.push(value);
+    }
+    else {
+      sum -= buffer[pos];
+      buffer[pos] = value;
+      pos = (pos + 1) % count;
+    }
+    sum += value;
+    return sum / buffer.length;
+  };
+}
+)";
+}
+
 QmlCustomFunction::QmlCustomFunction(const std::string &linkedPlot,
                                      const SnippetData &snippet):
   CustomFunction(linkedPlot,snippet)
@@ -11,6 +61,7 @@ QmlCustomFunction::QmlCustomFunction(const std::string &linkedPlot,
 void QmlCustomFunction::initEngine()
 {
   _qml_engine = std::make_unique<QJSEngine>();
+  _qml_engine->evaluate(FILTERS_SCRIPT);
   QJSValue globalVarResult = _qml_engine->evaluate(_global_vars);
   if(globalVarResult.isError())
   {
@@ -34,23 +85,15 @@ void QmlCustomFunction::initEngine()
 
 PlotData::Point QmlCustomFunction::calculatePoint(
   const PlotData& src_data,
-  const std::vector<const PlotData*>& channels_data,
+  const std::vector<double>& channel_values,
   size_t point_index)
 {
   const PlotData::Point &old_point = src_data.at(point_index);
 
-  for(int chan_index = 0; chan_index < channels_data.size(); chan_index++)
+  for(size_t chan_index = 0; chan_index < channel_values.size(); chan_index++)
   {
-    double value;
-    const auto& chan_data = channels_data[chan_index];
-    int index = chan_data->getIndexFromX(old_point.x);
-    if(index != -1){
-      value = chan_data->at(index).y;
-    }
-    else{
-      value = std::numeric_limits<double>::quiet_NaN();
-    }
-    _chan_values_qml.setProperty(static_cast<quint32>(chan_index), QJSValue(value));
+    _chan_values_qml.setProperty(static_cast<quint32>(chan_index),
+                                 QJSValue(channel_values[chan_index]));
   }
 
   PlotData::Point new_point;
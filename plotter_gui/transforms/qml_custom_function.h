@@ -13,8 +13,12 @@ public:
   void initEngine() override;
 
   virtual PlotData::Point calculatePoint(const PlotData & src_data,
-                                         const std::vector<const PlotData *> & channels_data,
+                                         const std::vector<double> & channel_values,
                                          size_t point_index) override;
+
+  // QJSEngine has the affinity of the thread that created it
+  bool isThreadSafe() const override { return false; }
+
 private:
 
   std::unique_ptr<QJSEngine> _qml_engine;
@@ -37,7 +37,7 @@ TransformSelector::TransformSelector(QStringList builtin_transform,
         auto item_name = new QTableWidgetItem(QString::fromStdString(it.first));
         auto item_combo = new QComboBox();
         item_combo->insertItems(0, transforms);
-        item_combo->insertSeparator(3);
+        item_combo->insertSeparator( builtin_transform.size() );
         ui->tableWidget->setItem(row, 0, item_name);
         ui->tableWidget->setCellWidget(row, 1, item_combo);
         if( transforms.contains( trans ) )
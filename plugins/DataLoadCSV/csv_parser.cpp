@@ -0,0 +1,720 @@
+#include "csv_parser.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <QLocale>
+#include <QString>
+
+namespace {
+
+inline bool isSeparator(char c)
+{
+    return c == ',' || c == ';' || c == '|';
+}
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// the powers of 10 that are exactly representable as double
+const double EXACT_POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const int MAX_EXACT_POW10 = 22;
+const uint64_t MAX_EXACT_MANTISSA = uint64_t(1) << 53;
+
+// dates and times like "2019-05-31T10:20:30.123Z" or "10:20:30.123"
+bool isTimestamp(const char* begin, const char* end)
+{
+    if( begin == end || !isDigit(*begin) ){
+        return false;
+    }
+    bool has_colon = false;
+    for( const char* ptr = begin; ptr < end; ptr++ )
+    {
+        const char c = *ptr;
+        if( !isDigit(c) && c != '-' && c != ':' && c != '/' && c != '.' &&
+            c != 'T' && c != 'Z' && c != ' ' )
+        {
+            return false;
+        }
+        has_colon |= (c == ':');
+    }
+    const bool is_date = (end - begin >= 10) && begin[4] == '-' && begin[7] == '-';
+    return has_colon || is_date;
+}
+
+inline const char* cellEnd(const char* cell, const char* line_end)
+{
+    while( cell < line_end && !isSeparator(*cell) ) { cell++; }
+    return cell;
+}
+
+inline const char* lineEnd(const char* line, const char* end)
+{
+    const char* newline = static_cast<const char*>( std::memchr( line, '\n', end - line ) );
+    return newline ? newline : end;
+}
+
+//---------------------------------------------------
+
+// days since 1970-01-01 of a date of the (proleptic) Gregorian calendar
+int64_t daysFromCivil(int64_t year, int month, int day)
+{
+    year -= (month <= 2);
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+struct DateTime
+{
+    bool has_date = false;
+    int year = 1970;
+    int month = 1;
+    int day = 1;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    double fraction = 0;
+    int zone_offset = 0; // seconds
+
+    bool toSeconds(double& value) const
+    {
+        if( month < 1 || month > 12 || day < 1 || day > 31 ||
+            hour > 24 || minute > 59 || second > 60 )
+        {
+            return false;
+        }
+        const int64_t seconds = (has_date ? daysFromCivil(year, month, day) * 86400 : 0) +
+                                hour * 3600 + minute * 60 + second - zone_offset;
+        value = static_cast<double>(seconds) + fraction;
+        return true;
+    }
+};
+
+bool readDigits(const char*& ptr, const char* end, int min_digits, int max_digits, int& value)
+{
+    value = 0;
+    int count = 0;
+    for( ; ptr < end && count < max_digits && isDigit(*ptr); ptr++, count++ )
+    {
+        value = value * 10 + (*ptr - '0');
+    }
+    return count >= min_digits;
+}
+
+bool readChar(const char*& ptr, const char* end, char c)
+{
+    if( ptr < end && *ptr == c )
+    {
+        ptr++;
+        return true;
+    }
+    return false;
+}
+
+// the digits after the decimal point
+bool readFraction(const char*& ptr, const char* end, double& fraction)
+{
+    double scale = 0.1;
+    fraction = 0;
+    const char* begin = ptr;
+    for( ; ptr < end && isDigit(*ptr); ptr++, scale *= 0.1 )
+    {
+        fraction += (*ptr - '0') * scale;
+    }
+    return ptr > begin;
+}
+
+// "Z", "+HH", "+HHMM" or "+HH:MM"
+bool readZone(const char*& ptr, const char* end, int& offset)
+{
+    if( readChar( ptr, end, 'Z' ) )
+    {
+        offset = 0;
+        return true;
+    }
+    if( ptr == end || (*ptr != '+' && *ptr != '-') ){
+        return false;
+    }
+    const int sign = (*ptr++ == '-') ? -1 : 1;
+    int hours = 0;
+    int minutes = 0;
+    if( !readDigits( ptr, end, 2, 2, hours ) ){
+        return false;
+    }
+    readChar( ptr, end, ':' );
+    readDigits( ptr, end, 2, 2, minutes );
+    offset = sign * (hours * 3600 + minutes * 60);
+    return true;
+}
+
+// HH:MM[:SS[.fff]]
+bool readTime(const char*& ptr, const char* end, DateTime& date_time)
+{
+    if( !readDigits( ptr, end, 1, 2, date_time.hour ) || !readChar( ptr, end, ':' ) ||
+        !readDigits( ptr, end, 2, 2, date_time.minute ) )
+    {
+        return false;
+    }
+    if( readChar( ptr, end, ':' ) )
+    {
+        if( !readDigits( ptr, end, 2, 2, date_time.second ) ){
+            return false;
+        }
+        if( (readChar( ptr, end, '.' ) || readChar( ptr, end, ',' )) &&
+            !readFraction( ptr, end, date_time.fraction ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseISO8601(const char* ptr, const char* end, DateTime& date_time)
+{
+    if( end - ptr >= 10 && ptr[4] == '-' )
+    {
+        date_time.has_date = true;
+        if( !readDigits( ptr, end, 4, 4, date_time.year ) || !readChar( ptr, end, '-' ) ||
+            !readDigits( ptr, end, 2, 2, date_time.month ) || !readChar( ptr, end, '-' ) ||
+            !readDigits( ptr, end, 2, 2, date_time.day ) )
+        {
+            return false;
+        }
+        if( ptr == end ){
+            return true;
+        }
+        if( !readChar( ptr, end, 'T' ) && !readChar( ptr, end, ' ' ) ){
+            return false;
+        }
+    }
+    if( !readTime( ptr, end, date_time ) ){
+        return false;
+    }
+    if( ptr < end && !readZone( ptr, end, date_time.zone_offset ) ){
+        return false;
+    }
+    return ptr == end;
+}
+
+bool readMonthName(const char*& ptr, const char* end, int& month)
+{
+    static const char* MONTHS[] = { "jan", "feb", "mar", "apr", "may", "jun",
+                                    "jul", "aug", "sep", "oct", "nov", "dec" };
+    if( end - ptr < 3 ){
+        return false;
+    }
+    for (int i=0; i<12; i++)
+    {
+        bool match = true;
+        for (int c=0; c<3; c++)
+        {
+            const char lower = (ptr[c] >= 'A' && ptr[c] <= 'Z') ? ptr[c] - 'A' + 'a' : ptr[c];
+            match &= (lower == MONTHS[i][c]);
+        }
+        if( match )
+        {
+            month = i + 1;
+            ptr += 3;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parsePattern(const char* ptr, const char* end, const std::string& pattern, DateTime& date_time)
+{
+    for (size_t i=0; i < pattern.size(); i++)
+    {
+        const char p = pattern[i];
+        if( p != '%' || i+1 == pattern.size() )
+        {
+            if( !readChar( ptr, end, p ) ){
+                return false;
+            }
+            continue;
+        }
+        bool ok = true;
+        switch( pattern[++i] )
+        {
+        case 'Y': ok = readDigits( ptr, end, 4, 4, date_time.year );
+            date_time.has_date = true;
+            break;
+        case 'y': ok = readDigits( ptr, end, 2, 2, date_time.year );
+            date_time.year += (date_time.year < 69) ? 2000 : 1900;
+            date_time.has_date = true;
+            break;
+        case 'm': ok = readDigits( ptr, end, 1, 2, date_time.month );
+            date_time.has_date = true;
+            break;
+        case 'b': ok = readMonthName( ptr, end, date_time.month );
+            date_time.has_date = true;
+            break;
+        case 'd': ok = readDigits( ptr, end, 1, 2, date_time.day );
+            date_time.has_date = true;
+            break;
+        case 'H': ok = readDigits( ptr, end, 1, 2, date_time.hour );   break;
+        case 'M': ok = readDigits( ptr, end, 1, 2, date_time.minute ); break;
+        case 'S': ok = readDigits( ptr, end, 1, 2, date_time.second );
+            if( ok && (readChar( ptr, end, '.' ) || readChar( ptr, end, ',' )) )
+            {
+                ok = readFraction( ptr, end, date_time.fraction );
+            }
+            break;
+        case 'f': ok = readFraction( ptr, end, date_time.fraction ); break;
+        case 'z': ok = readZone( ptr, end, date_time.zone_offset ); break;
+        default:  ok = readChar( ptr, end, pattern[i] ); break;
+        }
+        if( !ok ){
+            return false;
+        }
+    }
+    return ptr == end;
+}
+
+// integer number of units since the epoch, converted to seconds
+bool parseEpoch(const char* begin, const char* end, uint64_t units_per_second, double& value)
+{
+    const bool negative = (begin < end && *begin == '-');
+    if( negative ){
+        begin++;
+    }
+    if( begin == end || end - begin > 19 ){
+        return false;
+    }
+    uint64_t units = 0;
+    for( ; begin < end; begin++ )
+    {
+        if( !isDigit(*begin) ){
+            return false;
+        }
+        units = units * 10 + uint64_t(*begin - '0');
+    }
+    value = double( units / units_per_second ) +
+            double( units % units_per_second ) / double( units_per_second );
+    value = negative ? -value : value;
+    return true;
+}
+
+// numbers with many digits, "nan", "inf", etc.
+bool slowParseDouble(const char* begin, const char* end, double& value)
+{
+    bool ok = false;
+    value = QLocale::c().toDouble( QString::fromLatin1( begin, int(end - begin) ), &ok );
+    return ok;
+}
+
+}
+
+CSVParser::CSVParser(const std::vector<ColumnType>& column_types, int time_index,
+                     const TimeFormat& time_format):
+    _column_types(column_types),
+    _time_index(time_index),
+    _time_format(time_format)
+{
+}
+
+std::vector<CSVParser::Block> CSVParser::split(const char* begin, const char* end, size_t block_size)
+{
+    std::vector<Block> blocks;
+    const char* block_begin = begin;
+    while( block_begin < end )
+    {
+        const char* block_end = end;
+        if( size_t(end - block_begin) > block_size )
+        {
+            const char* newline = static_cast<const char*>(
+                        std::memchr( block_begin + block_size, '\n', end - block_begin - block_size ) );
+            block_end = newline ? newline + 1 : end;
+        }
+        blocks.push_back( { block_begin, block_end } );
+        block_begin = block_end;
+    }
+    return blocks;
+}
+
+std::vector<CSVParser::ColumnType> CSVParser::detectColumnTypes(const char* begin, const char* end,
+                                                                size_t column_count)
+{
+    const int SAMPLE_POSITIONS = 16;
+    const int LINES_PER_POSITION = 16;
+
+    struct Votes{
+        size_t integer = 0;
+        size_t number = 0;
+        size_t timestamp = 0;
+        size_t text = 0;
+    };
+    std::vector<Votes> votes( column_count );
+
+    std::vector<std::pair<const char*, const char*>> cells;
+    cells.reserve( column_count );
+
+    for (int pos = 0; pos < SAMPLE_POSITIONS; pos++)
+    {
+        // from the beginning of the line that follows the position
+        const char* line = begin + (end - begin) * pos / SAMPLE_POSITIONS;
+        if( line != begin )
+        {
+            line = lineEnd( line, end );
+            line = (line < end) ? line + 1 : end;
+        }
+
+        for (int count = 0; count < LINES_PER_POSITION && line < end; count++)
+        {
+            const char* line_end = lineEnd( line, end );
+            const char* next_line = (line_end < end) ? line_end + 1 : end;
+
+            cells.clear();
+            for( const char* cell = line; cells.size() <= column_count; )
+            {
+                const char* cell_end = cellEnd( cell, line_end );
+                cells.push_back( { cell, cell_end } );
+                if( cell_end == line_end ){
+                    break;
+                }
+                cell = cell_end + 1;
+            }
+
+            if( cells.size() == column_count )
+            {
+                for (size_t i=0; i < column_count; i++)
+                {
+                    const char* cell = cells[i].first;
+                    const char* cell_end = cells[i].second;
+                    while( cell < cell_end && isSpace(*cell) ) { cell++; }
+                    while( cell < cell_end && isSpace(*(cell_end-1)) ) { cell_end--; }
+
+                    double value;
+                    if( cell == cell_end ){
+                        continue;
+                    }
+                    else if( parseInteger( cell, cell_end, value ) ){
+                        votes[i].integer++;
+                    }
+                    else if( parseDouble( cell, cell_end, value ) ){
+                        votes[i].number++;
+                    }
+                    else if( isTimestamp( cell, cell_end ) ){
+                        votes[i].timestamp++;
+                    }
+                    else{
+                        votes[i].text++;
+                    }
+                }
+            }
+            line = next_line;
+        }
+    }
+
+    std::vector<ColumnType> types( column_count, NUMBER );
+    for (size_t i=0; i < column_count; i++)
+    {
+        const Votes& vote = votes[i];
+        if( vote.number == 0 && vote.integer > 0 ){
+            types[i] = INTEGER;
+        }
+        else if( vote.number == 0 && vote.integer == 0 && vote.text > 0 ){
+            types[i] = TEXT;
+        }
+        else if( vote.number == 0 && vote.integer == 0 && vote.timestamp > 0 ){
+            types[i] = TIMESTAMP;
+        }
+    }
+    return types;
+}
+
+bool CSVParser::parseInteger(const char* begin, const char* end, double& value)
+{
+    while( begin < end && isSpace(*begin) ) { begin++; }
+    while( begin < end && isSpace(*(end-1)) ) { end--; }
+
+    const bool negative = (begin < end && *begin == '-');
+    if( begin < end && (*begin == '-' || *begin == '+') ){
+        begin++;
+    }
+    if( begin == end || end - begin > 18 ){
+        return false;
+    }
+    int64_t result = 0;
+    for( ; begin < end; begin++ )
+    {
+        if( !isDigit(*begin) ){
+            return false;
+        }
+        result = result * 10 + (*begin - '0');
+    }
+    // 18 digits don't always fit in the mantissa of a double, the conversion rounds
+    value = static_cast<double>( negative ? -result : result );
+    return true;
+}
+
+bool CSVParser::parseDouble(const char* begin, const char* end, double& value)
+{
+    while( begin < end && isSpace(*begin) ) { begin++; }
+    while( begin < end && isSpace(*(end-1)) ) { end--; }
+    if( begin == end ){
+        return false;
+    }
+
+    const char* ptr = begin;
+    const bool negative = (*ptr == '-');
+    if( *ptr == '-' || *ptr == '+' ){
+        ptr++;
+    }
+    // quick rejection of the text, without calling the slow parser
+    if( ptr == end || !(isDigit(*ptr) || *ptr == '.') )
+    {
+        const char c = (ptr == end) ? 0 : *ptr;
+        if( c == 'n' || c == 'N' || c == 'i' || c == 'I' ){
+            return slowParseDouble( begin, end, value );
+        }
+        return false;
+    }
+
+    // up to 19 significant digits fit in the mantissa
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+    bool has_digits = false;
+
+    for( ; ptr < end && isDigit(*ptr); ptr++ )
+    {
+        has_digits = true;
+        const int digit = *ptr - '0';
+        if( digits < 19 )
+        {
+            mantissa = mantissa * 10 + digit;
+            digits += (mantissa != 0);
+        }
+        else{
+            exponent++;
+            truncated |= (digit != 0);
+        }
+    }
+    if( ptr < end && *ptr == '.' )
+    {
+        for( ptr++; ptr < end && isDigit(*ptr); ptr++ )
+        {
+            has_digits = true;
+            const int digit = *ptr - '0';
+            if( digits < 19 )
+            {
+                mantissa = mantissa * 10 + digit;
+                digits += (mantissa != 0);
+                exponent--;
+            }
+            else{
+                truncated |= (digit != 0);
+            }
+        }
+    }
+    if( !has_digits ){
+        return false;
+    }
+    if( ptr < end && (*ptr == 'e' || *ptr == 'E') )
+    {
+        ptr++;
+        const bool negative_exp = (ptr < end && *ptr == '-');
+        if( ptr < end && (*ptr == '-' || *ptr == '+') ){
+            ptr++;
+        }
+        if( ptr == end ){
+            return false;
+        }
+        int exp = 0;
+        for( ; ptr < end && isDigit(*ptr); ptr++ )
+        {
+            exp = std::min( exp * 10 + (*ptr - '0'), 100000 );
+        }
+        exponent += negative_exp ? -exp : exp;
+    }
+    if( ptr != end ){
+        return false;
+    }
+
+    if( mantissa == 0 )
+    {
+        value = negative ? -0.0 : 0.0;
+        return true;
+    }
+    // both the mantissa and the power of 10 are exact, therefore the result
+    // of a single multiplication or division is correctly rounded
+    if( !truncated && mantissa <= MAX_EXACT_MANTISSA &&
+        exponent >= -MAX_EXACT_POW10 && exponent <= MAX_EXACT_POW10 )
+    {
+        double result = static_cast<double>(mantissa);
+        result = (exponent < 0) ? result / EXACT_POW10[-exponent] :
+                                  result * EXACT_POW10[exponent];
+        value = negative ? -result : result;
+        return true;
+    }
+    return slowParseDouble( begin, end, value );
+}
+
+bool CSVParser::parseTimestamp(const char* begin, const char* end,
+                               const TimeFormat& format, double& value)
+{
+    while( begin < end && isSpace(*begin) ) { begin++; }
+    while( begin < end && isSpace(*(end-1)) ) { end--; }
+
+    DateTime date_time;
+    switch( format.type )
+    {
+    case TimeFormat::AUTO:
+        return parseDouble( begin, end, value ) ||
+                ( parseISO8601( begin, end, date_time ) && date_time.toSeconds( value ) );
+    case TimeFormat::EPOCH_MS:
+        return parseEpoch( begin, end, 1000, value );
+    case TimeFormat::EPOCH_US:
+        return parseEpoch( begin, end, 1000000, value );
+    case TimeFormat::EPOCH_NS:
+        return parseEpoch( begin, end, 1000000000, value );
+    case TimeFormat::PATTERN:
+        return parsePattern( begin, end, format.pattern, date_time ) && date_time.toSeconds( value );
+    }
+    return false;
+}
+
+void CSVParser::parse(const Block& block, Result& result,
+                      std::atomic<size_t>* progress,
+                      const std::atomic<bool>* cancel) const
+{
+    const size_t PROGRESS_STEP = 256 * 1024;
+    const size_t column_count = _column_types.size();
+
+    std::vector<size_t> parsed_columns;
+    for (size_t i=0; i < column_count; i++)
+    {
+        const ColumnType type = _column_types[i];
+        if( type == NUMBER || type == INTEGER ){
+            parsed_columns.push_back( i );
+        }
+    }
+
+    // the number of newlines is an upper bound of the number of lines
+    size_t max_lines = 1;
+    for( const char* ptr = block.begin; (ptr = lineEnd( ptr, block.end )) < block.end; ptr++ )
+    {
+        max_lines++;
+    }
+    result.columns.resize( column_count );
+    for (size_t i: parsed_columns)
+    {
+        result.columns[i].reserve( max_lines );
+    }
+    if( _time_index >= 0 ){
+        result.time.reserve( max_lines );
+    }
+
+    std::vector<double> row( column_count );
+
+    double prev_time = -std::numeric_limits<double>::max();
+    const char* reported = block.begin;
+    const char* line = block.begin;
+
+    while( line < block.end )
+    {
+        const char* line_end = lineEnd( line, block.end );
+        const char* next_line = (line_end < block.end) ? line_end + 1 : block.end;
+
+        if( line_end > line && *(line_end-1) == '\r' ){
+            line_end--;
+        }
+
+        if( line_end > line )
+        {
+            size_t column = 0;
+            double time = std::numeric_limits<double>::quiet_NaN();
+            const char* cell = line;
+            while( column < column_count )
+            {
+                const char* cell_end = cellEnd( cell, line_end );
+
+                const ColumnType type = _column_types[column];
+                const bool numeric = (type == INTEGER || type == NUMBER);
+                if( numeric )
+                {
+                    double value;
+                    const bool valid = ( type == INTEGER && parseInteger( cell, cell_end, value ) ) ||
+                                       parseDouble( cell, cell_end, value );
+                    row[column] = valid ? value : std::numeric_limits<double>::quiet_NaN();
+                }
+                if( int(column) == _time_index )
+                {
+                    // the number of seconds is already there
+                    if( numeric && _time_format.type == TimeFormat::AUTO && !std::isnan( row[column] ) ){
+                        time = row[column];
+                    }
+                    else if( !parseTimestamp( cell, cell_end, _time_format, time ) ){
+                        time = std::numeric_limits<double>::quiet_NaN();
+                    }
+                }
+                column++;
+
+                if( cell_end == line_end ){
+                    cell = nullptr;
+                    break;
+                }
+                cell = cell_end + 1;
+            }
+
+            // lines with too few or too many cells are skipped
+            if( column == column_count && cell == nullptr )
+            {
+                if( _time_index >= 0 )
+                {
+                    const double t = time;
+                    if( std::isnan(t) )
+                    {
+                        result.error = Result::INVALID_TIME;
+                        break;
+                    }
+                    if( t < prev_time )
+                    {
+                        result.error = Result::NOT_MONOTONIC;
+                        break;
+                    }
+                    result.equal_time |= (t == prev_time);
+                    prev_time = t;
+                    result.time.push_back( t );
+                }
+                for (size_t i: parsed_columns)
+                {
+                    result.columns[i].push_back( row[i] );
+                }
+                result.lines++;
+            }
+        }
+
+        line = next_line;
+
+        if( size_t(line - reported) >= PROGRESS_STEP )
+        {
+            if( progress ){
+                progress->fetch_add( line - reported );
+            }
+            reported = line;
+            if( cancel && cancel->load() ){
+                return;
+            }
+        }
+    }
+
+    if( progress ){
+        progress->fetch_add( block.end - reported );
+    }
+}
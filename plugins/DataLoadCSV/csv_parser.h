@@ -0,0 +1,118 @@
+#ifndef CSV_PARSER_H
+#define CSV_PARSER_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+ * Parser of the lines of a CSV file, already in memory (usually mapped).
+ * The text is split in blocks of whole lines, that can be parsed in parallel
+ * by different threads; the results are then appended in order.
+ *
+ * The cells are separated by ',', ';' or '|'. The lines that don't have
+ * one cell per column are skipped, as the empty ones.
+ */
+class CSVParser
+{
+public:
+
+    /// Only NUMBER and INTEGER columns are parsed, the cells of the others are skipped.
+    enum ColumnType { NUMBER, INTEGER, TIMESTAMP, TEXT };
+
+    /// How the cells of the time column are converted to seconds.
+    struct TimeFormat
+    {
+        TimeFormat(): type(AUTO) {}
+
+        enum Type {
+            AUTO,     // numbers are seconds, otherwise ISO 8601 or time of the day
+            EPOCH_MS, // integers, since 1970-01-01 UTC
+            EPOCH_US,
+            EPOCH_NS,
+            PATTERN   // see parseTimestamp()
+        };
+        Type type;
+        std::string pattern;
+    };
+
+    struct Block{
+        const char* begin;
+        const char* end;
+    };
+
+    struct Result
+    {
+        enum Error { NONE, INVALID_TIME, NOT_MONOTONIC };
+
+        // one value per valid line, empty if the time is the index of the line
+        std::vector<double> time;
+        // one vector per column, with NaN where the cell isn't a number.
+        // Empty if the column isn't parsed.
+        std::vector<std::vector<double>> columns;
+        size_t lines = 0;
+
+        // the parsing stops at the first error
+        Error error = NONE;
+        bool equal_time = false;
+    };
+
+    /**
+     * time_index is the column of the time, or -1 to use the index of the line.
+     * The time column is always parsed, whatever its type, with time_format.
+     */
+    CSVParser(const std::vector<ColumnType>& column_types, int time_index,
+              const TimeFormat& time_format = TimeFormat());
+
+    /// Split [begin,end) in blocks of about block_size bytes, ending with a newline.
+    static std::vector<Block> split(const char* begin, const char* end, size_t block_size);
+
+    /**
+     * Guess the type of the columns from a sample of the lines, taken in different
+     * parts of [begin,end). Empty cells are ignored; a column is TEXT (or TIMESTAMP)
+     * only if none of the cells of the sample is a number.
+     */
+    static std::vector<ColumnType> detectColumnTypes(const char* begin, const char* end,
+                                                     size_t column_count);
+
+    /**
+     * Thread-safe. The number of bytes parsed is added to progress once in a
+     * while; the parsing is interrupted (the result is incomplete) if cancel is set.
+     */
+    void parse(const Block& block, Result& result,
+               std::atomic<size_t>* progress = nullptr,
+               const std::atomic<bool>* cancel = nullptr) const;
+
+    /**
+     * Conversion that doesn't depend on the locale: the decimal separator is
+     * always '.'. Spaces around the number are ignored. Returns false if the
+     * text isn't a number.
+     */
+    static bool parseDouble(const char* begin, const char* end, double& value);
+
+    /// Faster than parseDouble(), but only for integers with up to 18 digits.
+    static bool parseInteger(const char* begin, const char* end, double& value);
+
+    /**
+     * Seconds since 1970-01-01 UTC of a date and time, or seconds since midnight
+     * if there is only the time of the day. Nothing is allocated.
+     *
+     * AUTO accepts "2019-05-31T10:20:30.123", "2019-05-31 10:20:30", "10:20:30.5",
+     * optionally followed by the time zone ("Z", "+02:00", "-0500").
+     *
+     * In the PATTERN the fields are %Y (year), %y (2 digits year), %m (month),
+     * %b (abbreviated name of the month), %d (day), %H, %M, %S (seconds, with
+     * an optional fraction), %f (fraction of second), %z (time zone) and %%.
+     * Any other character must match exactly.
+     */
+    static bool parseTimestamp(const char* begin, const char* end,
+                               const TimeFormat& format, double& value);
+
+private:
+    std::vector<ColumnType> _column_types;
+    int _time_index;
+    TimeFormat _time_format;
+};
+
+#endif // CSV_PARSER_H
@@ -1,11 +1,36 @@
 #include "dataload_csv.h"
-#include <QTextStream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <thread>
+#include <QComboBox>
 #include <QFile>
+#include <QFormLayout>
+#include <QLineEdit>
 #include <QMessageBox>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QSettings>
 #include <QProgressDialog>
 #include "PlotJuggler/selectlistdialog.h"
+#include "csv_parser.h"
+#include "marl/defer.h"
+#include "marl/scheduler.h"
+#include "marl/thread.h"
+#include "marl/waitgroup.h"
+
+// the blocks of the file are parsed in parallel
+const size_t PARSER_BLOCK_SIZE = 4 * 1024 * 1024;
+
+// in the order of CSVParser::TimeFormat::Type, saved in the layout
+static const QStringList& TimeFormatNames()
+{
+    static const QStringList names = { "auto", "epoch_ms", "epoch_us", "epoch_ns", "pattern" };
+    return names;
+}
 
 DataLoadCSV::DataLoadCSV()
 {
@@ -19,18 +44,10 @@ const std::vector<const char*> &DataLoadCSV::compatibleFileExtensions() const
     return _extensions;
 }
 
-QSize DataLoadCSV::parseHeader(QFile *file, std::vector<std::string>& ordered_names)
+void DataLoadCSV::parseHeader(const QString& first_line, std::vector<std::string>& ordered_names)
 {
-    QTextStream inA(file);
-
-    QString first_line = inA.readLine();
-    QString second_line = inA.readLine();
-
     QStringList firstline_items = first_line.split(csv_separator);
 
-    int linecount = 0;
-    const int columncount = firstline_items.count();
-
     for (int i=0; i < firstline_items.size(); i++ )
     {
         // remove annoying prefix
@@ -42,17 +59,6 @@ QSize DataLoadCSV::parseHeader(QFile *file, std::vector<std::string>& ordered_na
         }
         ordered_names.push_back( field_name.toStdString() );
     }
-
-    while (!inA.atEnd())
-    {
-        inA.readLine();
-        linecount++;
-    }
-
-    QSize table_size;
-    table_size.setWidth( columncount);
-    table_size.setHeight( linecount );
-    return table_size;
 }
 
 bool DataLoadCSV::readDataFromFile(FileLoadInfo* info, PlotDataMapRef& plot_data)
@@ -70,34 +76,48 @@ bool DataLoadCSV::readDataFromFile(FileLoadInfo* info, PlotDataMapRef& plot_data
     int time_index = TIME_INDEX_NOT_DEFINED;
 
     QFile file( info->filename );
-    file.open(QFile::ReadOnly);
-
-    std::vector<std::string> column_names;
+    if( !file.open(QFile::ReadOnly) )
+    {
+        return false;
+    }
 
-    const QSize table_size = parseHeader( &file, column_names);
-    const int tot_lines   = table_size.height() -1;
-    const int columncount = table_size.width();
+    // the file is parsed in place, without copying it
+    const qint64 file_size = file.size();
+    const char* file_begin = reinterpret_cast<const char*>( file.map(0, file_size) );
+    QByteArray file_content;
+    if( !file_begin )
+    {
+        // empty file, or a file system that doesn't support mapping
+        file_content = file.readAll();
+        file_begin = file_content.constData();
+    }
+    const char* file_end = file_begin + ( file_content.isNull() ? file_size : file_content.size() );
 
-    file.close();
-    file.open(QFile::ReadOnly);
-    QTextStream inB( &file );
+    const char UTF8_BOM[] = "\xEF\xBB\xBF";
+    if( file_end - file_begin >= 3 && std::memcmp( file_begin, UTF8_BOM, 3 ) == 0 )
+    {
+        file_begin += 3;
+    }
 
-    std::vector<PlotData*> plots_vector;
+    const char* header_end = static_cast<const char*>( std::memchr( file_begin, '\n', file_end - file_begin ) );
+    const char* body_begin = header_end ? header_end + 1 : file_end;
+    if( !header_end )
+    {
+        header_end = file_end;
+    }
+    if( header_end > file_begin && *(header_end-1) == '\r' )
+    {
+        header_end--;
+    }
 
-    bool interrupted = false;
+    std::vector<std::string> column_names;
+    parseHeader( QString::fromUtf8( file_begin, int(header_end - file_begin) ), column_names );
 
-    int linecount = 0;
+    // the columns of text don't become series
+    const std::vector<CSVParser::ColumnType> column_types =
+            CSVParser::detectColumnTypes( body_begin, file_end, column_names.size() );
 
-    QProgressDialog progress_dialog;
-    progress_dialog.setLabelText("Loading... please wait");
-    progress_dialog.setWindowModality( Qt::ApplicationModal );
-    progress_dialog.setRange(0, tot_lines -1);
-    progress_dialog.setAutoClose( true );
-    progress_dialog.setAutoReset( true );
-    progress_dialog.show();
-
-    // remove first line (header)
-    inB.readLine();
+    std::vector<PlotData*> plots_vector;
 
     //---- build plots_vector from header  ------
     std::deque<std::string> valid_field_names;
@@ -106,10 +126,16 @@ bool DataLoadCSV::readDataFromFile(FileLoadInfo* info, PlotDataMapRef& plot_data
     {
         const std::string& field_name = ( column_names[i] );
 
-        auto it = plot_data.addNumeric(field_name);
-
         valid_field_names.push_back( field_name );
-        plots_vector.push_back( &(it->second) );
+
+        if( column_types[i] == CSVParser::NUMBER || column_types[i] == CSVParser::INTEGER )
+        {
+            auto it = plot_data.addNumeric(field_name);
+            plots_vector.push_back( &(it->second) );
+        }
+        else{
+            plots_vector.push_back( nullptr );
+        }
 
         if (time_index == TIME_INDEX_NOT_DEFINED && use_provided_configuration)
         {
@@ -126,6 +152,36 @@ bool DataLoadCSV::readDataFromFile(FileLoadInfo* info, PlotDataMapRef& plot_data
 
         SelectFromListDialog* dialog = new SelectFromListDialog( valid_field_names );
         dialog->setWindowTitle("Select the time axis");
+
+        // how the cells of the time column are converted to seconds
+        QWidget* time_format_widget = new QWidget();
+        QFormLayout* time_format_layout = new QFormLayout( time_format_widget );
+        time_format_layout->setContentsMargins( 0, 0, 0, 0 );
+
+        QComboBox* time_format_combo = new QComboBox();
+        time_format_combo->addItem( "Seconds, ISO 8601 date or HH:MM:SS", CSVParser::TimeFormat::AUTO );
+        time_format_combo->addItem( "Epoch, milliseconds", CSVParser::TimeFormat::EPOCH_MS );
+        time_format_combo->addItem( "Epoch, microseconds", CSVParser::TimeFormat::EPOCH_US );
+        time_format_combo->addItem( "Epoch, nanoseconds",  CSVParser::TimeFormat::EPOCH_NS );
+        time_format_combo->addItem( "Custom pattern",      CSVParser::TimeFormat::PATTERN );
+        time_format_combo->setCurrentIndex( time_format_combo->findData( _time_format.type ) );
+
+        QLineEdit* time_pattern_edit = new QLineEdit( QString::fromStdString( _time_format.pattern ) );
+        time_pattern_edit->setPlaceholderText( "%d/%m/%Y %H:%M:%S" );
+        time_pattern_edit->setToolTip( "Fields: %Y %y %m %b %d %H %M %S %f %z" );
+        time_pattern_edit->setEnabled( _time_format.type == CSVParser::TimeFormat::PATTERN );
+
+        connect( time_format_combo, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+                 time_pattern_edit, [time_format_combo, time_pattern_edit](int index)
+        {
+            const int type = time_format_combo->itemData( index ).toInt();
+            time_pattern_edit->setEnabled( type == CSVParser::TimeFormat::PATTERN );
+        });
+
+        time_format_layout->addRow( "Time format:", time_format_combo );
+        time_format_layout->addRow( "Pattern:", time_pattern_edit );
+        dialog->addOptionsWidget( time_format_widget );
+
         int res = dialog->exec();
 
         if (res == QDialog::Rejected )
@@ -133,6 +189,9 @@ bool DataLoadCSV::readDataFromFile(FileLoadInfo* info, PlotDataMapRef& plot_data
             return false;
         }
 
+        _time_format.type = static_cast<CSVParser::TimeFormat::Type>( time_format_combo->currentData().toInt() );
+        _time_format.pattern = time_pattern_edit->text().toStdString();
+
         const int selected_item = dialog->getSelectedRowNumber().at(0);
         if( selected_item > 0)
         {
@@ -149,80 +208,145 @@ bool DataLoadCSV::readDataFromFile(FileLoadInfo* info, PlotDataMapRef& plot_data
     }
 
     //-----------------
-    double prev_time = - std::numeric_limits<double>::max();
-    bool monotonic_warning = false;
+    QProgressDialog progress_dialog;
+    progress_dialog.setLabelText("Loading... please wait");
+    progress_dialog.setWindowModality( Qt::ApplicationModal );
+    progress_dialog.setRange(0, 100);
+    progress_dialog.setAutoClose( true );
+    progress_dialog.setAutoReset( true );
+    progress_dialog.show();
 
-    while (!inB.atEnd() )
-    {
-        QString line = inB.readLine();
+    QElapsedTimer timer;
+    timer.start();
 
-        QStringList string_items = line.split(csv_separator);
-        if( string_items.size() != columncount)
-        {
-          continue;
-        }
-        double t = linecount;
+    const CSVParser parser( column_types, std::max( time_index, -1 ), _time_format );
+    const std::vector<CSVParser::Block> blocks = CSVParser::split( body_begin, file_end, PARSER_BLOCK_SIZE );
+    std::vector<CSVParser::Result> results( blocks.size() );
+
+    marl::Scheduler scheduler;
+    scheduler.setWorkerThreadCount( marl::Thread::numLogicalCPUs() );
+    scheduler.bind();
+    defer(scheduler.unbind());  // unbind before destructing the scheduler.
 
-        if( time_index >= 0)
+    std::atomic<size_t> parsed_bytes(0);
+    std::atomic<size_t> parsed_blocks(0);
+    std::atomic<bool> interrupted(false);
+    marl::WaitGroup parse_wg( blocks.size() );
+
+    for (size_t i=0; i < blocks.size(); i++)
+    {
+        marl::schedule([&, i]
         {
-            bool is_number = false;
-            t = string_items[ time_index ].toDouble(&is_number);
+            parser.parse( blocks[i], results[i], &parsed_bytes, &interrupted );
+            parsed_blocks++;
+            parse_wg.done();
+        });
+    }
 
-            if( !is_number)
-            {
-                QMessageBox::StandardButton reply;
-                reply = QMessageBox::warning(0, tr("Error reading file"),
-                                              tr("One of the timestamps is not a valid number. Abort\n") );
+    const size_t body_size = std::max<size_t>( 1, file_end - body_begin );
+    while( parsed_blocks < blocks.size() )
+    {
+        progress_dialog.setValue( static_cast<int>( 100 * parsed_bytes / body_size ) );
+        QApplication::processEvents();
+        if( progress_dialog.wasCanceled() ) {
+            interrupted = true;
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds(20) );
+    }
+    parse_wg.wait();
 
-                return false;
-            }
-            if( t < prev_time )
-            {
-                QMessageBox::StandardButton reply;
-                reply = QMessageBox::warning(0, tr("Error reading file"),
-                                              tr("Selected time in not strictly monotonic. Loading will be aborted\n") );
+    if(interrupted)
+    {
+        progress_dialog.cancel();
+        plot_data.numeric.clear();
+        return true;
+    }
 
-                return false;
-            }
-            else if (t == prev_time)
+    // check the timestamps where the blocks join
+    double prev_time = - std::numeric_limits<double>::max();
+    bool monotonic_warning = false;
+
+    for (const auto& result: results)
+    {
+        CSVParser::Result::Error error = result.error;
+        if( !result.time.empty() )
+        {
+            if( result.time.front() < prev_time )
             {
-                monotonic_warning = true;
+                error = CSVParser::Result::NOT_MONOTONIC;
             }
-
-            prev_time = t;
+            monotonic_warning |= ( result.time.front() == prev_time || result.equal_time );
+            prev_time = result.time.back();
         }
 
-        int index = 0;
-        for (int i=0; i < string_items.size(); i++ )
+        if( error == CSVParser::Result::INVALID_TIME )
         {
-            bool is_number = false;
-            double y = string_items[i].toDouble(&is_number);
-            if( is_number )
-            {
-                PlotData::Point point( t,y );
-                plots_vector[index]->pushBack( point );
-            }
-            index++;
+            QMessageBox::warning(0, tr("Error reading file"),
+                                 tr("One of the timestamps is not a valid number. Abort\n") );
+            return false;
         }
+        if( error == CSVParser::Result::NOT_MONOTONIC )
+        {
+            QMessageBox::warning(0, tr("Error reading file"),
+                                 tr("Selected time in not strictly monotonic. Loading will be aborted\n") );
+            return false;
+        }
+    }
 
-        if(linecount++ %100 == 0)
+    // Append the blocks in order, one task per series. Columns with the same
+    // name share the series: their values are interleaved, line by line.
+    std::map<PlotData*, std::vector<size_t>> series_columns;
+    for (size_t i=0; i < plots_vector.size(); i++)
+    {
+        if( plots_vector[i] )
         {
-            progress_dialog.setValue( linecount );
-            QApplication::processEvents();
-            if( progress_dialog.wasCanceled() ) {
-                interrupted = true;
-                break;
-            }
+            series_columns[ plots_vector[i] ].push_back( i );
         }
     }
-    file.close();
 
-    if(interrupted)
+    size_t total_lines = 0;
+    for (const auto& result: results)
     {
-        progress_dialog.cancel();
-        plot_data.numeric.clear();
+        total_lines += result.lines;
     }
 
+    marl::WaitGroup append_wg( series_columns.size() );
+
+    for (const auto& it: series_columns)
+    {
+        PlotData* plot = it.first;
+        const std::vector<size_t>* columns = &it.second;
+
+        marl::schedule([&, plot, columns]
+        {
+            plot->reserve( plot->size() + total_lines * columns->size() );
+
+            size_t line_index = 0;
+            for (auto& result: results)
+            {
+                for (size_t line = 0; line < result.lines; line++)
+                {
+                    const double t = (time_index >= 0) ? result.time[line] :
+                                                         double( line_index + line );
+                    for (size_t column: *columns)
+                    {
+                        // NaN, i.e. not a number, is skipped by pushBack()
+                        plot->pushBack( PlotData::Point( t, result.columns[column][line] ) );
+                    }
+                }
+                line_index += result.lines;
+                for (size_t column: *columns)
+                {
+                    std::vector<double>().swap( result.columns[column] );
+                }
+            }
+            append_wg.done();
+        });
+    }
+    append_wg.wait();
+
+    qDebug() << "The loading operation took" << timer.elapsed() << "milliseconds";
+
     if( monotonic_warning )
     {
         QString message = "Two consecutive samples had the same X value (i.e. time).\n"
@@ -244,6 +368,11 @@ bool DataLoadCSV::xmlSaveState(QDomDocument &doc, QDomElement &parent_element) c
 {
     QDomElement elem = doc.createElement("default");
     elem.setAttribute("time_axis", _default_time_axis.c_str() );
+    elem.setAttribute("time_format", TimeFormatNames().at( _time_format.type ) );
+    if( _time_format.type == CSVParser::TimeFormat::PATTERN )
+    {
+        elem.setAttribute("time_pattern", QString::fromStdString( _time_format.pattern ) );
+    }
 
     parent_element.appendChild( elem );
     return true;
@@ -254,6 +383,12 @@ bool DataLoadCSV::xmlLoadState(const QDomElement &parent_element)
     QDomElement elem = parent_element.firstChildElement( "default" );
     if( !elem.isNull()    )
     {
+        // the older layouts don't have a time format: the time is a number
+        const int format = TimeFormatNames().indexOf( elem.attribute("time_format") );
+        _time_format.type = (format < 0) ? CSVParser::TimeFormat::AUTO :
+                                           static_cast<CSVParser::TimeFormat::Type>( format );
+        _time_format.pattern = elem.attribute("time_pattern").toStdString();
+
         if( elem.hasAttribute("time_axis") )
         {
             _default_time_axis = elem.attribute("time_axis").toStdString();
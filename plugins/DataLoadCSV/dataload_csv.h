@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QtPlugin>
 #include "PlotJuggler/dataloader_base.h"
+#include "csv_parser.h"
 
 
 class  DataLoadCSV: public DataLoader
@@ -27,13 +28,15 @@ public:
     virtual bool xmlLoadState(const QDomElement &parent_element ) override;
 
 protected:
-    QSize parseHeader(QFile *file, std::vector<std::string> &ordered_names);
+    void parseHeader(const QString& first_line, std::vector<std::string> &ordered_names);
 
 private:
     std::vector<const char*> _extensions;
 
     std::string _default_time_axis;
 
+    CSVParser::TimeFormat _time_format;
+
 
 };
 
@@ -1,5 +1,4 @@
 #include "dataload_ulog.h"
-#include <QTextStream>
 #include <QFile>
 #include <QMessageBox>
 #include <QDebug>
@@ -33,29 +32,29 @@ bool DataLoadULog::readDataFromFile(FileLoadInfo* fileload_info, PlotDataMapRef&
 {
     const auto& filename = fileload_info->filename;
 
-    ULogParser parser( filename.toStdString() );
-
-    const auto& timeseries_map = parser.getTimeseriesMap();
+    QFile file( filename );
+    if( !file.open(QFile::ReadOnly) )
+    {
+        throw std::runtime_error("ULog: Failed to open replay file" );
+    }
 
-    for( const auto& it: timeseries_map)
+    // the parser reads the messages in place
+    const qint64 file_size = file.size();
+    const char* file_data = reinterpret_cast<const char*>( file.map(0, file_size) );
+    QByteArray file_content;
+    if( !file_data )
     {
-        const std::string& sucsctiption_name =  it.first;
-        const ULogParser::Timeseries& timeseries = it.second;
+        file_content = file.readAll();
+        file_data = file_content.constData();
+    }
 
-        for (const auto& data: timeseries.data )
-        {
-            std::string series_name = sucsctiption_name + data.first;
+    QSettings settings;
+    const bool compact_storage = settings.value("Preferences::compact_storage", false).toBool();
 
-            auto series = plot_data.addNumeric( series_name );
+    ULogParser parser( file_data, file_content.isNull() ? size_t(file_size) : size_t(file_content.size()),
+                       plot_data, compact_storage );
 
-            for( size_t i=0; i < data.second.size(); i++ )
-            {
-                double msg_time = static_cast<double>(timeseries.timestamps[i]) * 0.000001;
-                PlotData::Point point( msg_time, data.second[i] );
-                series->second.pushBack( point );
-            }
-        }
-    }
+    file.close();
 
     ULogParametersDialog* dialog = new ULogParametersDialog( parser, _main_win );
     dialog->setWindowTitle( QString("ULog file %1").arg(filename) );
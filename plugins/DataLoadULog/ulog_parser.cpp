@@ -1,49 +1,83 @@
 #include "ulog_parser.h"
 #include "ulog_messages.h"
 
-#include <fstream>
+#include <algorithm>
+#include <functional>
 #include <string.h>
 #include <iosfwd>
 #include <sstream>
 #include <iomanip>
-using ios = std::ios;
 
+namespace {
 
+// the fields in the log aren't aligned
+template <typename T> inline T readValue(const void* ptr)
+{
+    T value;
+    memcpy( &value, ptr, sizeof(T) );
+    return value;
+}
 
-ULogParser::ULogParser(const std::string &filename):
-    _file_start_time(0)
+template <typename T> double decodeField(const char* ptr)
 {
-    std::ifstream replay_file (filename, std::ifstream::in);
+    return static_cast<double>( readValue<T>(ptr) );
+}
+
+}
 
-    if (!replay_file.is_open())
+ULogParser::FieldCodec ULogParser::fieldCodec(FormatType type)
+{
+    switch( type )
     {
-        throw std::runtime_error ("ULog: Failed to open replay file" );
-    }
+    case UINT8:  return { 1, &decodeField<uint8_t> };
+    case INT8:   return { 1, &decodeField<int8_t> };
+    case UINT16: return { 2, &decodeField<uint16_t> };
+    case INT16:  return { 2, &decodeField<int16_t> };
+    case UINT32: return { 4, &decodeField<uint32_t> };
+    case INT32:  return { 4, &decodeField<int32_t> };
+    case UINT64: return { 8, &decodeField<uint64_t> };
+    case INT64:  return { 8, &decodeField<int64_t> };
+    case FLOAT:  return { 4, &decodeField<float> };
+    case DOUBLE: return { 8, &decodeField<double> };
+    case CHAR:   return { 1, &decodeField<char> };
+    case BOOL:   return { 1, &decodeField<bool> };
+    case OTHER:  break;
+    }
+    throw std::runtime_error("ULog: unexpected field type");
+}
+
 
-    bool ret = readFileHeader(replay_file);
 
-    if( !ret )
+ULogParser::ULogParser(const char *data, size_t size, PlotDataMapRef &plot_data, bool compact_storage):
+    _file_start_time(0),
+    _plot_data(plot_data),
+    _compact_storage(compact_storage)
+{
+    if( !readFileHeader(data, size) )
     {
         throw std::runtime_error("ULog: wrong header");
     }
 
-    if( ! readFileDefinitions(replay_file) )
+    if( ! readFileDefinitions(data, size) )
     {
         throw std::runtime_error("ULog: error loading definitions");
     }
 
-    replay_file.seekg(_data_section_start);
-
+    // the appended data (hardfault dumps) isn't parsed
+    const size_t data_end = std::min<uint64_t>( size, _read_until_file_position );
+    size_t offset = _data_section_start;
 
-    while (replay_file)
+    while ( offset + ULOG_MSG_HEADER_LEN <= data_end )
     {
-        ulog_message_header_s message_header;
-        replay_file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+        const auto message_header = readValue<ulog_message_header_s>( data + offset );
+        offset += ULOG_MSG_HEADER_LEN;
 
-        _read_buffer.reserve(message_header.msg_size + 1);
-        char *message = (char *)_read_buffer.data();
-        replay_file.read(message, message_header.msg_size);
-        message[message_header.msg_size] = '\0';
+        if( offset + message_header.msg_size > data_end )
+        {
+            break; // truncated log
+        }
+        const char *message = data + offset;
+        offset += message_header.msg_size;
 
         switch (message_header.msg_type)
         {
@@ -51,8 +85,8 @@ ULogParser::ULogParser(const std::string &filename):
         {
             Subscription sub;
 
-            sub.multi_id = *reinterpret_cast<uint8_t*>(message);
-            sub.msg_id   = *reinterpret_cast<uint16_t*>( message+1 );
+            sub.multi_id = readValue<uint8_t>( message );
+            sub.msg_id   = readValue<uint16_t>( message+1 );
             message += 3;
             sub.message_name.assign( message, message_header.msg_size - 3 );
 
@@ -61,11 +95,25 @@ ULogParser::ULogParser(const std::string &filename):
             {
                 sub.format = &it->second;
             }
-            _subscriptions.insert( {sub.msg_id, sub} );
 
-            if( sub.multi_id > 0 )
+            if( sub.msg_id >= _decoders.size() )
             {
-                _message_name_with_multi_id.insert( sub.message_name );
+                _decoders.resize( sub.msg_id + 1 );
+            }
+            Decoder& decoder = _decoders[sub.msg_id];
+            decoder = Decoder();
+            decoder.active = true;
+            decoder.subscription = sub;
+
+            if( sub.multi_id > 0 && _message_name_with_multi_id.insert( sub.message_name ).second )
+            {
+                // the name of the series of this message changes, from now on
+                for(auto& other: _decoders)
+                {
+                    if( other.subscription.message_name == sub.message_name ){
+                        other.compiled = false;
+                    }
+                }
             }
 
 //            printf("ADD_LOGGED_MSG: %d %d %s\n", sub.msg_id, sub.multi_id, sub.message_name.c_str() );
@@ -73,22 +121,32 @@ ULogParser::ULogParser(const std::string &filename):
         }break;
         case (int)ULogMessageType::REMOVE_LOGGED_MSG: printf("REMOVE_LOGGED_MSG\n" );
         {
-            uint16_t msg_id = *reinterpret_cast<uint16_t*>( message );
-            _subscriptions.erase( msg_id );
+            uint16_t msg_id = readValue<uint16_t>( message );
+            if( msg_id < _decoders.size() )
+            {
+                _decoders[msg_id].active = false;
+            }
 
         } break;
         case (int)ULogMessageType::DATA:
         {
-            uint16_t msg_id = *reinterpret_cast<uint16_t*>( message );
-            message += 2;
-            auto sub_it = _subscriptions.find( msg_id );
-            if( sub_it == _subscriptions.end() )
+            uint16_t msg_id = readValue<uint16_t>( message );
+            if( msg_id >= _decoders.size() || !_decoders[msg_id].active ||
+                !_decoders[msg_id].subscription.format )
             {
                 continue;
             }
-            const Subscription& sub = sub_it->second;
-
-            parseDataMessage(sub, message);
+            Decoder& decoder = _decoders[msg_id];
+            if( !decoder.compiled )
+            {
+                compileDecoder( decoder );
+            }
+            // timestamp and fields
+            if( message_header.msg_size < 2 + sizeof(uint64_t) + decoder.payload_size )
+            {
+                continue;
+            }
+            parseDataMessage( decoder, message + 2 );
 
         } break;
 
@@ -97,7 +155,7 @@ ULogParser::ULogParser(const std::string &filename):
             MessageLog msg;
             msg.level = static_cast<char>( message[0] );
             message += sizeof( char );
-            msg.timestamp = *reinterpret_cast<uint64_t*>(message);
+            msg.timestamp = readValue<uint64_t>(message);
             message += sizeof( uint64_t );
             msg.msg.assign( message, message_header.msg_size - 9 );
             //printf("LOG %c (%ld): %s\n", msg.level, msg.timestamp, msg.msg.c_str() );
@@ -120,18 +178,21 @@ ULogParser::ULogParser(const std::string &filename):
     }
 }
 
-void ULogParser::parseDataMessage(const ULogParser::Subscription &sub, char *message)
+void ULogParser::parseDataMessage(const Decoder &decoder, const char *message)
 {
-    size_t other_fields_count = 0;
-    std::string ts_name = sub.message_name;
+    const double timestamp = static_cast<double>( readValue<uint64_t>(message) ) * 0.000001;
+    message += sizeof(uint64_t);
 
-    for(const auto& field: sub.format->fields)
+    for (const DecodeOp& op: decoder.ops)
     {
-        if( field.type == OTHER)
-        {
-            other_fields_count++;
-        }
+        op.series->pushBack( PlotData::Point( timestamp, op.decode( message + op.offset ) ) );
     }
+}
+
+void ULogParser::compileDecoder(Decoder &decoder)
+{
+    const Subscription& sub = decoder.subscription;
+    std::string ts_name = sub.message_name;
 
     if( _message_name_with_multi_id.count(ts_name) > 0 )
     {
@@ -140,111 +201,54 @@ void ULogParser::parseDataMessage(const ULogParser::Subscription &sub, char *mes
         ts_name += std::string(buff);
     }
 
-    // get the timeseries or create if if it doesn't exist
-    auto ts_it = _timeseries.find( ts_name );
-    if( ts_it == _timeseries.end() )
+    // get the series or create them if they don't exist
+    auto series_it = _series.find( ts_name );
+    if( series_it == _series.end() )
     {
-        ts_it = _timeseries.insert( { ts_name, createTimeseries(sub.format)  } ).first;
+        series_it = _series.insert( { ts_name, createSeries(sub.format, ts_name)  } ).first;
     }
-    Timeseries& timeseries = ts_it->second;
-
-    uint64_t time_val = *reinterpret_cast<uint64_t*>(message);
-    timeseries.timestamps.push_back( time_val );
-    message += sizeof(uint64_t);
 
     size_t index = 0;
-    parseSimpleDataMessage(timeseries, sub.format, message, &index);
-
+    size_t offset = 0;
+    size_t end = 0;
+    decoder.ops.clear();
+    compileFormat( *sub.format, series_it->second, &index, &offset, &end, decoder.ops );
+    // the writers may leave the trailing padding out of the message
+    decoder.payload_size = end;
+    decoder.compiled = true;
 }
 
-char* ULogParser::parseSimpleDataMessage(Timeseries& timeseries, const Format *format,
-                                         char *message, size_t* index)
+void ULogParser::compileFormat(const Format& format, const std::vector<PlotData*>& series,
+                               size_t* index, size_t* offset, size_t* end,
+                               std::vector<DecodeOp>& ops) const
 {
-    for (const auto& field: format->fields)
+    for (const auto& field: format.fields)
     {
         // skip _padding messages which are one byte in size
         if (StringView(field.field_name).starts_with("_padding")) {
-            message += field.array_size;
+            *offset += field.array_size;
             continue;
         }
 
         for (int array_pos = 0; array_pos < field.array_size; array_pos++)
         {
-            double value = 0;
-            switch( field.type )
+            if( field.type == OTHER )
             {
-            case UINT8:{
-                value = static_cast<double>( *reinterpret_cast<uint8_t*>(message));
-                message += 1;
-            }break;
-            case INT8:{
-                value = static_cast<double>( *reinterpret_cast<int8_t*>(message));
-                message += 1;
-            }break;
-            case UINT16:{
-                value = static_cast<double>( *reinterpret_cast<uint16_t*>(message));
-                message += 2;
-            }break;
-            case INT16:{
-                value = static_cast<double>( *reinterpret_cast<int16_t*>(message));
-                message += 2;
-            }break;
-            case UINT32:{
-                value = static_cast<double>( *reinterpret_cast<uint32_t*>(message));
-                message += 4;
-            }break;
-            case INT32:{
-                value = static_cast<double>( *reinterpret_cast<int32_t*>(message));
-                message += 4;
-            }break;
-            case UINT64:{
-                value = static_cast<double>( *reinterpret_cast<uint64_t*>(message));
-                message += 8;
-            }break;
-            case INT64:{
-                value = static_cast<double>( *reinterpret_cast<int64_t*>(message));
-                message += 8;
-            }break;
-            case FLOAT:{
-                value = static_cast<double>( *reinterpret_cast<float*>(message));
-                message += 4;
-            }break;
-            case DOUBLE:{
-                value = ( *reinterpret_cast<double*>(message));
-                message += 8;
-            }break;
-            case CHAR:{
-                    value =  static_cast<double>( *reinterpret_cast<char*>(message));
-                    message += 1;
-            }break;
-            case BOOL:{
-                value =  static_cast<double>( *reinterpret_cast<bool*>(message));
-                message += 1;
-            }break;
-            case OTHER:{
                 //recursion!!!
-                auto child_format = _formats.at( field.other_type_ID );
-                message += sizeof(uint64_t); // skip timestamp
-                message = parseSimpleDataMessage(timeseries, &child_format, message, index );
-            }break;
-
-            } // end switch
-
-            if( field.type != OTHER)
-            {
-                timeseries.data[(*index)++].second.push_back( value );
+                *offset += sizeof(uint64_t); // skip timestamp
+                compileFormat( _formats.at( field.other_type_ID ), series, index, offset, end, ops );
             }
-        } //end for
+            else{
+                const FieldCodec codec = fieldCodec( field.type );
+                ops.push_back( { *offset, codec.decode, series[(*index)++] } );
+                *offset += codec.size;
+                *end = std::max( *end, *offset );
+            }
+        }
     }
-    return message;
 }
 
 
-const std::map<std::string, ULogParser::Timeseries> &ULogParser::getTimeseriesMap() const
-{
-    return _timeseries;
-}
-
 const std::vector<ULogParser::Parameter>& ULogParser::getParameters() const
 {
     return _parameters;
@@ -261,21 +265,6 @@ const std::vector<ULogParser::MessageLog> &ULogParser::getLogs() const
 }
 
 
-bool ULogParser::readSubscription(std::ifstream &file, uint16_t msg_size)
-{
-    _read_buffer.reserve(msg_size + 1);
-    char *message = (char *)_read_buffer.data();
-
-    file.read(message, msg_size);
-    message[msg_size] = 0;
-
-    if (!file) {
-        return false;
-    }
-
-    return true;
-}
-
 size_t ULogParser::fieldsCount(const ULogParser::Format &format) const
 {
     size_t count = 0;
@@ -316,15 +305,12 @@ std::vector<StringView> ULogParser::splitString(const StringView &strToSplit, ch
 
 
 
-bool ULogParser::readFileHeader(std::ifstream &file)
+bool ULogParser::readFileHeader(const char *data, size_t size)
 {
-    file.seekg(0);
-    ulog_file_header_s msg_header;
-    file.read((char *)&msg_header, sizeof(msg_header));
-
-    if (!file) {
+    if( size < sizeof(ulog_file_header_s) ) {
         return false;
     }
+    const auto msg_header = readValue<ulog_file_header_s>( data );
 
     _file_start_time = msg_header.timestamp;
 
@@ -340,36 +326,39 @@ bool ULogParser::readFileHeader(std::ifstream &file)
     return memcmp(magic, msg_header.magic, 7) == 0;
 }
 
-bool ULogParser::readFileDefinitions(std::ifstream &file)
+bool ULogParser::readFileDefinitions(const char *data, size_t size)
 {
-    ulog_message_header_s message_header;
-    file.seekg(sizeof(ulog_file_header_s));
+    size_t offset = sizeof(ulog_file_header_s);
 
     while (true)
     {
-        file.read((char *)&message_header, ULOG_MSG_HEADER_LEN);
+        if( offset + ULOG_MSG_HEADER_LEN > size ) {
+            return false;
+        }
+        const auto message_header = readValue<ulog_message_header_s>( data + offset );
+        const char *message = data + offset + ULOG_MSG_HEADER_LEN;
 
-        if (!file) {
+        if( offset + ULOG_MSG_HEADER_LEN + message_header.msg_size > size ) {
             return false;
         }
 
         switch (message_header.msg_type)
         {
         case (int)ULogMessageType::FLAG_BITS:
-            if (!readFlagBits(file, message_header.msg_size)) {
+            if (!readFlagBits(message, message_header.msg_size)) {
                 return false;
             }
             break;
 
         case (int)ULogMessageType::FORMAT:
-            if (!readFormat(file, message_header.msg_size)) {
+            if (!readFormat(message, message_header.msg_size)) {
                 return false;
             }
 
             break;
 
         case (int)ULogMessageType::PARAMETER:
-            if (!readParameter(file, message_header.msg_size)) {
+            if (!readParameter(message, message_header.msg_size)) {
                 return false;
             }
 
@@ -377,45 +366,42 @@ bool ULogParser::readFileDefinitions(std::ifstream &file)
 
         case (int)ULogMessageType::ADD_LOGGED_MSG:
         {
-            _data_section_start = file.tellg() - (std::streamoff)ULOG_MSG_HEADER_LEN;
+            _data_section_start = offset;
             return true;
         }
 
         case (int)ULogMessageType::INFO:
         {
-            if (!readInfo(file, message_header.msg_size)) {
+            if (!readInfo(message, message_header.msg_size)) {
                 return false;
             }
         }break;
         case (int)ULogMessageType::INFO_MULTIPLE: //skip
-            file.seekg(message_header.msg_size, ios::cur);
             break;
 
         default:
             printf("unknown log definition type %i, size %i (offset %i)",
-                   (int)message_header.msg_type, (int)message_header.msg_size, (int)file.tellg());
-            file.seekg(message_header.msg_size, ios::cur);
+                   (int)message_header.msg_type, (int)message_header.msg_size, (int)offset);
             break;
         }
+        offset += ULOG_MSG_HEADER_LEN + message_header.msg_size;
     }
     return true;
 }
 
 
 
-bool ULogParser::readFlagBits(std::ifstream &file, uint16_t msg_size)
+bool ULogParser::readFlagBits(const char *buffer, uint16_t msg_size)
 {
     if (msg_size != 40) {
         printf("unsupported message length for FLAG_BITS message (%i)", msg_size);
         return false;
     }
 
-    _read_buffer.reserve(msg_size);
-    uint8_t *message = (uint8_t *)_read_buffer.data();
-    file.read((char *)message, msg_size);
+    const uint8_t *message = reinterpret_cast<const uint8_t*>(buffer);
 
-    //uint8_t *compat_flags = message;
-    uint8_t *incompat_flags = message + 8;
+    //const uint8_t *compat_flags = message;
+    const uint8_t *incompat_flags = message + 8;
 
     // handle & validate the flags
     bool contains_appended_data = incompat_flags[0] & ULOG_INCOMPAT_FLAG0_DATA_APPENDED_MASK;
@@ -450,20 +436,9 @@ bool ULogParser::readFlagBits(std::ifstream &file, uint16_t msg_size)
     return true;
 }
 
-bool ULogParser::readFormat(std::ifstream &file, uint16_t msg_size)
+bool ULogParser::readFormat(const char *buffer, uint16_t msg_size)
 {
-    static int count = 0;
-
-    _read_buffer.reserve(msg_size + 1);
-    char *buffer = (char *)_read_buffer.data();
-    file.read(buffer, msg_size);
-    buffer[msg_size] = 0;
-
-    if (!file) {
-        return false;
-    }
-
-    std::string str_format(buffer);
+    std::string str_format(buffer, strnlen(buffer, msg_size));
     size_t pos = str_format.find(':');
 
     if (pos == std::string::npos) {
@@ -605,15 +580,10 @@ std::string int_to_hex( T i )
   return stream.str();
 }
 
-bool ULogParser::readInfo(std::ifstream &file, uint16_t msg_size)
+bool ULogParser::readInfo(const char *buffer, uint16_t msg_size)
 {
-    _read_buffer.reserve(msg_size);
-    uint8_t *message = (uint8_t *)_read_buffer.data();
-    file.read((char *)message, msg_size);
+    const uint8_t *message = reinterpret_cast<const uint8_t*>(buffer);
 
-    if (!file) {
-        return false;
-    }
     uint8_t key_len = message[0];
     message++;
     std::string raw_key((char *)message, key_len);
@@ -695,15 +665,9 @@ bool ULogParser::readInfo(std::ifstream &file, uint16_t msg_size)
     return true;
 }
 
-bool ULogParser::readParameter(std::ifstream &file, uint16_t msg_size)
+bool ULogParser::readParameter(const char *buffer, uint16_t msg_size)
 {
-    _read_buffer.reserve(msg_size);
-    uint8_t *message = (uint8_t *)_read_buffer.data();
-    file.read((char *)message, msg_size);
-
-    if (!file) {
-        return false;
-    }
+    const uint8_t *message = reinterpret_cast<const uint8_t*>(buffer);
 
     uint8_t key_len = message[0];
     std::string key((char *)message + 1, key_len);
@@ -721,12 +685,12 @@ bool ULogParser::readParameter(std::ifstream &file, uint16_t msg_size)
 
     if( type == "int32_t" )
     {
-        param.value.val_int = *reinterpret_cast<int32_t*>(message + 1 + key_len);
+        param.value.val_int = readValue<int32_t>(message + 1 + key_len);
         param.val_type = INT32;
     }
     else if( type == "float" )
     {
-        param.value.val_real = *reinterpret_cast<float*>(message + 1 + key_len);
+        param.value.val_real = readValue<float>(message + 1 + key_len);
         param.val_type = FLOAT;
     }
     else {
@@ -738,13 +702,14 @@ bool ULogParser::readParameter(std::ifstream &file, uint16_t msg_size)
 
 
 
-ULogParser::Timeseries ULogParser::createTimeseries(const ULogParser::Format* format)
+std::vector<PlotData*> ULogParser::createSeries(const ULogParser::Format* format,
+                                                const std::string& name)
 {
     std::function<void(const Format& format, const std::string& prefix)> appendVector;
 
-    Timeseries timeseries;
+    std::vector<PlotData*> series;
 
-    appendVector = [&appendVector,this, &timeseries](const Format& format, const std::string& prefix)
+    appendVector = [&appendVector,this, &series](const Format& format, const std::string& prefix)
     {
         for( const auto& field: format.fields)
         {
@@ -765,7 +730,9 @@ ULogParser::Timeseries ULogParser::createTimeseries(const ULogParser::Format* fo
                 }
                 if( field.type != OTHER )
                 {
-                    timeseries.data.push_back( {new_prefix + array_suffix, std::vector<double>()} );
+                    auto it = _plot_data.addNumeric( new_prefix + array_suffix );
+                    it->second.setCompactStorage( _compact_storage );
+                    series.push_back( &it->second );
                 }
                 else{
                     appendVector( this->_formats.at( field.other_type_ID ), new_prefix + array_suffix);
@@ -774,6 +741,6 @@ ULogParser::Timeseries ULogParser::createTimeseries(const ULogParser::Format* fo
         }
     };
 
-    appendVector(*format, {});
-    return timeseries;
+    appendVector(*format, name);
+    return series;
 }
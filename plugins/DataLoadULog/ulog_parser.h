@@ -7,6 +7,7 @@
 #include <set>
 
 #include "string_view.hpp"
+#include "PlotJuggler/plotdata.h"
 
 typedef  nonstd::string_view StringView;
 
@@ -65,17 +66,14 @@ public:
         const Format* format;
     };
 
-    struct Timeseries
-    {
-        std::vector<uint64_t> timestamps;
-        std::vector<std::pair<std::string,std::vector<double>>> data;
-    };
-
 public:
 
-    ULogParser(const std::string& filename);
-
-    const std::map<std::string, Timeseries> &getTimeseriesMap() const;
+    /**
+     * Parse a log already in memory, usually a mapped file, that isn't accessed
+     * anymore once the constructor returns. The fields of the data messages are
+     * appended directly to the series of plot_data, named "message[.multi_id]/field".
+     */
+    ULogParser(const char* data, size_t size, PlotDataMapRef& plot_data, bool compact_storage = false);
 
     const std::vector<Parameter> &getParameters() const;
 
@@ -84,31 +82,31 @@ public:
     const std::vector<MessageLog> &getLogs() const;
 
 private:
-    bool readFileHeader(std::ifstream &file);
-
-    bool readFileDefinitions(std::ifstream &file);
+    bool readFileHeader(const char* data, size_t size);
 
-    bool readFormat(std::ifstream &file, uint16_t msg_size);
+    bool readFileDefinitions(const char* data, size_t size);
 
-    bool readFlagBits(std::ifstream &file, uint16_t msg_size);
+    bool readFormat(const char* message, uint16_t msg_size);
 
-    bool readInfo(std::ifstream &file, uint16_t msg_size);
+    bool readFlagBits(const char* message, uint16_t msg_size);
 
-    bool readParameter(std::ifstream &file, uint16_t msg_size);
+    bool readInfo(const char* message, uint16_t msg_size);
 
-    bool readSubscription(std::ifstream &file, uint16_t msg_size);
+    bool readParameter(const char* message, uint16_t msg_size);
 
     size_t fieldsCount(const Format& format) const;
 
-    Timeseries createTimeseries(const Format* format);
+    std::vector<PlotData*> createSeries(const Format* format, const std::string& name);
 
     uint64_t _file_start_time;
 
-    std::vector<Parameter> _parameters;
+    PlotDataMapRef& _plot_data;
 
-    std::vector<uint8_t> _read_buffer;
+    bool _compact_storage;
 
-    std::streampos _data_section_start; ///< first ADD_LOGGED_MSG message
+    std::vector<Parameter> _parameters;
+
+    size_t _data_section_start; ///< offset of the first ADD_LOGGED_MSG message
 
     int64_t _read_until_file_position = 1ULL << 60; ///< read limit if log contains appended data
 
@@ -118,9 +116,45 @@ private:
 
     std::map<std::string, std::string> _info;
 
-    std::map<uint16_t,Subscription> _subscriptions;
+    /// A field of a data message, at a fixed offset after the timestamp.
+    struct DecodeOp
+    {
+        size_t offset;
+        double (*decode)(const char* ptr);
+        PlotData* series;
+    };
 
-    std::map<std::string, Timeseries> _timeseries;
+    struct FieldCodec
+    {
+        size_t size;
+        double (*decode)(const char* ptr);
+    };
+
+    static FieldCodec fieldCodec(FormatType type);
+
+    /**
+     * A subscription, whose format is compiled once, when its first message
+     * arrives, into the flat list of the fields to read.
+     */
+    struct Decoder
+    {
+        Decoder(): active(false), compiled(false), payload_size(0) {}
+        bool active; ///< between ADD_LOGGED_MSG and REMOVE_LOGGED_MSG
+        bool compiled;
+        Subscription subscription;
+        size_t payload_size; ///< bytes after the timestamp, up to the end of the last field
+        std::vector<DecodeOp> ops;
+    };
+
+    std::vector<Decoder> _decoders; ///< indexed by msg_id
+
+    void compileDecoder(Decoder& decoder);
+
+    void compileFormat(const Format& format, const std::vector<PlotData*>& series,
+                       size_t* index, size_t* offset, size_t* end,
+                       std::vector<DecodeOp>& ops) const;
+
+    std::map<std::string, std::vector<PlotData*>> _series; ///< one per field of the message
 
     std::vector<StringView> splitString(const StringView& strToSplit, char delimeter);
 
@@ -128,9 +162,7 @@ private:
 
     std::vector<MessageLog> _message_logs;
 
-    void parseDataMessage(const Subscription& sub, char *message);
-
-    char * parseSimpleDataMessage(Timeseries &timeseries, const Format* format, char *message, size_t* index);
+    void parseDataMessage(const Decoder& decoder, const char *message);
 };
 
 #endif // ULOG_PARSER_H
@@ -40,6 +40,7 @@ DataStreamSample::DataStreamSample()
         }
 
         const std::string name_str = name.toStdString();
+        param.id = streamID(name_str);
 
         dataMap().addNumeric(name_str);
         _parameters.insert( std::make_pair( name_str, param) );
@@ -80,24 +81,24 @@ bool DataStreamSample::xmlLoadState(const QDomElement &parent_element)
 
 void DataStreamSample::pushSingleCycle()
 {
-    std::lock_guard<std::mutex> lock( mutex() );
-
     using namespace std::chrono;
     static std::chrono::high_resolution_clock::time_point initial_time = high_resolution_clock::now();
     const double offset = duration_cast< duration<double>>( initial_time.time_since_epoch() ).count() ;
 
+    // published without locking mutex()
+    SampleBatch& batch = streamBatch();
+
     auto now =  high_resolution_clock::now();
-    for (auto& it: dataMap().numeric )
+    for (const auto& it: _parameters )
     {
-        if( it.first == "empty") continue;
-        auto par = _parameters[it.first];
+        const auto& par = it.second;
 
-        auto& plot = it.second;
         const double t = duration_cast< duration<double>>( now - initial_time ).count() ;
         double y =  par.A*sin(par.B*t + par.C) + par.D*t*0.05;
 
-        plot.pushBack( PlotData::Point( t + offset, y ) );
+        batch.pushNumeric( par.id, PlotData::Point( t + offset, y ) );
     }
+    publishBatch();
 }
 
 void DataStreamSample::loop()
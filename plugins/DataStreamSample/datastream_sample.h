@@ -36,6 +36,7 @@ private:
 
     struct Parameters{
         double A,B,C,D;
+        SampleBatch::StreamID id;
     };
 
     void loop();
@@ -78,51 +78,57 @@ void DataStreamROS::topicCallback(const topic_tools::ShapeShifter::ConstPtr& msg
       _ros_parser.setUseHeaderStamp( false );
     }
 
+    // the samples are published without locking mutex()
+    SampleBatch& batch = streamBatch();
+
     if( msg_time < _prev_clock_time )
     {
-        // clear
-        for (auto& it: dataMap().numeric ) {
-            it.second.clear();
-        }
-        for (auto& it: dataMap().user_defined ){
-            it.second.clear();
-        }
-        emit clearBuffers();
+        // the clock went back: the application drops all the samples received so far
+        batch.clearDestination();
     }
     _prev_clock_time = msg_time;
 
     MessageRef buffer_view( buffer );
     _ros_parser.pushMessageRef( topic_name, buffer_view, msg_time );
 
-    std::lock_guard<std::mutex> lock( mutex() );
-    const std::string prefixed_topic_name = _prefix + topic_name;
+    auto topic_it = _topics.find( topic_name );
+    if( topic_it == _topics.end() )
+    {
+        const std::string prefixed_topic_name = _prefix + topic_name;
+        topic_it = _topics.emplace( topic_name, TopicSeries() ).first;
+        topic_it->second.raw_id = streamID( prefixed_topic_name );
+        topic_it->second.index_id = streamID( prefixed_topic_name + "/_MSG_INDEX_" );
+    }
+    TopicSeries& topic = topic_it->second;
 
     // adding raw serialized msg for future uses.
     // do this before msg_time normalization
+    batch.pushUserDefined( topic.raw_id, PlotDataAny::Point(msg_time, nonstd::any(std::move(buffer)) ));
+
+    // the series of the topic are kept, only their samples are removed
+    _ros_parser.extractData(topic.parsed_data, _prefix);
+    if( topic.numeric.size() != topic.parsed_data.numeric.size() )
     {
-        auto plot_pair = dataMap().user_defined.find( prefixed_topic_name );
-        if( plot_pair == dataMap().user_defined.end() )
+        // new fields; the pointers to the other series are still valid
+        topic.numeric.clear();
+        for (auto& it: topic.parsed_data.numeric )
         {
-            plot_pair = dataMap().addUserDefined( prefixed_topic_name );
+            topic.numeric.push_back( { &it.second, streamID( it.first ) } );
         }
-        PlotDataAny& user_defined_data = plot_pair->second;
-        user_defined_data.pushBack( PlotDataAny::Point(msg_time, nonstd::any(std::move(buffer)) ));
     }
-
-    _ros_parser.extractData(dataMap(), _prefix);
-
-    //------------------------------
+    for (const auto& series: topic.numeric )
     {
-        int& index = _msg_index[topic_name];
-        index++;
-        const std::string key = prefixed_topic_name + ("/_MSG_INDEX_") ;
-        auto index_it = dataMap().numeric.find(key);
-        if( index_it == dataMap().numeric.end())
+        for (const auto& point: *series.first )
         {
-            index_it = dataMap().addNumeric( key );
+            batch.pushNumeric( series.second, point );
         }
-        index_it->second.pushBack( PlotData::Point(msg_time, index) );
+        series.first->clear();
     }
+
+    //------------------------------
+    topic.msg_index++;
+    batch.pushNumeric( topic.index_id, PlotData::Point(msg_time, topic.msg_index) );
+    publishBatch();
 }
 
 void DataStreamROS::extractInitialSamples()
@@ -306,8 +312,7 @@ bool DataStreamROS::start(QStringList* selected_datasources)
 
     {
         std::lock_guard<std::mutex> lock( mutex() );
-        dataMap().numeric.clear();
-        dataMap().user_defined.clear();
+        dataMap().clear();
     }
 
     using namespace RosIntrospection;
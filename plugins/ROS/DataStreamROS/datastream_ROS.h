@@ -80,12 +80,23 @@ private:
 
     QAction* _action_saveIntoRosbag;
 
-    std::map<std::string, int> _msg_index;
-
     DialogSelectRosTopics::Configuration _config;
 
     RosMessageParser _ros_parser;
 
+    // used only by topicCallback(): the series parsed from each topic, with their
+    // handles, are kept to push the samples without looking up their names
+    struct TopicSeries
+    {
+        TopicSeries(): msg_index(0) {}
+        PlotDataMapRef parsed_data;
+        std::vector<std::pair<PlotData*, SampleBatch::StreamID>> numeric;
+        SampleBatch::StreamID raw_id;
+        SampleBatch::StreamID index_id;
+        int msg_index;
+    };
+    std::unordered_map<std::string, TopicSeries> _topics;
+
     QTimer* _periodic_timer;
 
     bool _roscore_disconnection_already_notified;
@@ -207,22 +207,19 @@ void TopicPublisherROS::broadcastTF(double current_time)
 
     std::map<StringPair, geometry_msgs::TransformStamped> transforms;
 
-    for(const auto& data_it:  _datamap->user_defined )
-    {
-        const std::string& topic_name = data_it.first;
-        const PlotDataAny& plot_any = data_it.second;
+    resolveSeriesIDs();
 
-        if( !toPublish(topic_name) )
-        {
-            continue;// Not selected
-        }
+    for(const auto& topic: { std::make_pair(std::string("/tf_static"), _tf_static_id),
+                             std::make_pair(std::string("/tf"), _tf_id) } )
+    {
+        const std::string& topic_name = topic.first;
+        const PlotDataAny* tf_data = _datamap->userDefinedByID( topic.second );
 
-        if( topic_name != "/tf_static" && topic_name != "/tf")
+        if( !tf_data || !toPublish(topic_name) )
         {
-            continue;
+            continue;// Not available or not selected
         }
 
-         const PlotDataAny* tf_data = &plot_any;
          int last_index = tf_data->getIndexFromX( current_time );
          if( last_index < 0)
          {
@@ -300,6 +297,17 @@ void TopicPublisherROS::broadcastTF(double current_time)
     _tf_publisher->sendTransform(transforms_vector);
 }
 
+void TopicPublisherROS::resolveSeriesIDs()
+{
+    if( _resolved_datamap != _datamap )
+    {
+        _tf_id = _datamap->getID("/tf");
+        _tf_static_id = _datamap->getID("/tf_static");
+        _consecutive_msgs_id = _datamap->getID("__consecutive_message_instances__");
+        _resolved_datamap = _datamap;
+    }
+}
+
 bool TopicPublisherROS::toPublish(const std::string &topic_name)
 {
     auto it = _topics_to_publish.find( topic_name );
@@ -383,11 +391,10 @@ void TopicPublisherROS::updateState(double current_time)
     broadcastTF(current_time);
     //-----------------------------------------------
 
-    auto data_it = _datamap->user_defined.find( "__consecutive_message_instances__" );
-    if( data_it != _datamap->user_defined.end() )
+    const PlotDataAny* continuous_msgs = _datamap->userDefinedByID( _consecutive_msgs_id );
+    if( continuous_msgs )
     {
-        const PlotDataAny& continuous_msgs = data_it->second;
-        _previous_play_index = continuous_msgs.getIndexFromX(current_time);
+        _previous_play_index = continuous_msgs->getIndexFromX(current_time);
         //qDebug() << QString("u: %1").arg( current_index ).arg(current_time, 0, 'f', 4 );
     }
 
@@ -453,12 +460,14 @@ void TopicPublisherROS::play(double current_time)
         return;
     }
 
-    auto data_it = _datamap->user_defined.find( "__consecutive_message_instances__" );
-    if( data_it == _datamap->user_defined.end() )
+    resolveSeriesIDs();
+
+    const PlotDataAny* continuous_msgs_ptr = _datamap->userDefinedByID( _consecutive_msgs_id );
+    if( !continuous_msgs_ptr )
     {
         return;
     }
-    const PlotDataAny& continuous_msgs = data_it->second;
+    const PlotDataAny& continuous_msgs = *continuous_msgs_ptr;
     int current_index = continuous_msgs.getIndexFromX(current_time);
 
     if( _previous_play_index > current_index)
@@ -469,7 +478,7 @@ void TopicPublisherROS::play(double current_time)
     }
     else
     {
-        const PlotDataAny& consecutive_msg = data_it->second;
+        const PlotDataAny& consecutive_msg = continuous_msgs;
         for(int index = _previous_play_index+1; index <= current_index; index++)
         {
 
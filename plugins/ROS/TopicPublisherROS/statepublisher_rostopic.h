@@ -40,6 +40,13 @@ private:
 
     void broadcastTF(double current_time);
 
+    // handles of the series looked up at every update, valid for _resolved_datamap
+    void resolveSeriesIDs();
+    const PlotDataMapRef* _resolved_datamap = nullptr;
+    PlotDataMapRef::SeriesID _tf_id;
+    PlotDataMapRef::SeriesID _tf_static_id;
+    PlotDataMapRef::SeriesID _consecutive_msgs_id;
+
     std::map<std::string, ros::Publisher> _publishers;
     bool _enabled;
     ros::NodeHandlePtr _node;